@@ -0,0 +1,68 @@
+#ifndef MEGAMMAP_BENCHMARK_FLAT_TREE_H_
+#define MEGAMMAP_BENCHMARK_FLAT_TREE_H_
+
+#include <vector>
+#include "mega_mmap/macros.h"
+
+/** A pointer-free decision tree node, usable in place from a page */
+template<typename T>
+struct FlatNode {
+  int feature_;   /**< The feature compared at this node */
+  T joint_;       /**< The split value (the prediction at leaves) */
+  u64 left_;      /**< Index of the left child (kNoChild if none) */
+  u64 right_;     /**< Index of the right child (kNoChild if none) */
+};
+
+/**
+ * Decision trees stored as index-linked node arrays. Many trees can
+ * share one array (e.g., a POD vector), each identified by the index
+ * of its root, so prediction never deserializes a tree.
+ * */
+template<typename T>
+class FlatTree {
+ public:
+  static constexpr u64 kNoChild = (u64)-1;
+
+ public:
+  /**
+   * Append the nodes of a pointer-linked tree (e.g., Node<T>) in
+   * preorder
+   *
+   * @return The index of the root
+   * */
+  template<typename NodeT>
+  static u64 Flatten(const NodeT &node, std::vector<FlatNode<T>> &nodes) {
+    u64 idx = nodes.size();
+    nodes.emplace_back();
+    nodes[idx].feature_ = node.feature_;
+    nodes[idx].joint_ = node.joint_;
+    nodes[idx].left_ = kNoChild;
+    nodes[idx].right_ = kNoChild;
+    if (node.left_) {
+      u64 left = Flatten(*node.left_, nodes);
+      nodes[idx].left_ = left;
+    }
+    if (node.right_) {
+      u64 right = Flatten(*node.right_, nodes);
+      nodes[idx].right_ = right;
+    }
+    return idx;
+  }
+
+  /** Predict a row with the tree rooted at root */
+  template<typename VecT>
+  static T Predict(VecT &nodes, u64 root, const T &row) {
+    u64 idx = root;
+    while (true) {
+      FlatNode<T> &node = nodes[idx];
+      u64 next = row.LessThan(node.joint_, node.feature_) ?
+          node.left_ : node.right_;
+      if (next == kNoChild) {
+        return node.joint_;
+      }
+      idx = next;
+    }
+  }
+};
+
+#endif  // MEGAMMAP_BENCHMARK_FLAT_TREE_H_
@@ -25,22 +25,22 @@ void GrayScott::init_field() {
   const int V = (size_x + 2) * (size_y + 2) * (size_z + 2);
   u.Init("u", procs * V * V * V, MM_READ_WRITE);
   u.BoundMemory(settings.window_size);
-  u.EvenPgas(rank, procs, u.size());
+  u.EvenPgas(rank, procs, u.size(), mm::PgasLayout::kPageAligned);
   u.Allocate();
 
   v.Init("v", procs * V * V * V, MM_READ_WRITE);
   v.BoundMemory(settings.window_size);
-  v.EvenPgas(rank, procs, u.size());
+  v.EvenPgas(rank, procs, u.size(), mm::PgasLayout::kPageAligned);
   v.Allocate();
 
   u2.Init("u2", procs * V * V * V, MM_READ_WRITE);
   u2.BoundMemory(settings.window_size);
-  u2.EvenPgas(rank, procs, u.size());
+  u2.EvenPgas(rank, procs, u.size(), mm::PgasLayout::kPageAligned);
   u2.Allocate();
 
   v2.Init("v2", procs * V * V * V, MM_READ_WRITE);
   v2.BoundMemory(settings.window_size);
-  v2.EvenPgas(rank, procs, u.size());
+  v2.EvenPgas(rank, procs, u.size(), mm::PgasLayout::kPageAligned);
   v2.Allocate();
 //
 //  for (size_t i = 0; i < V; ++i) {
@@ -125,6 +125,7 @@ void GrayScott::init_mm() {
 }
 
 void GrayScott::iterate() {
+  MM_SPAN("GrayScottStep", "app", 0);
   calc(u, v, u2, v2);
 }
 
@@ -15,6 +15,9 @@
 
 #include "mega_mmap/vector_mmap_mpi.h"
 #include "mega_mmap/vector_mega_mpi.h"
+#include "mega_mmap/source/hdf5_source.h"
+#include "mega_mmap/vector_concept.h"
+#include "mega_mmap/scheduler.h"
 #include "test_types.h"
 
 namespace stdfs = std::filesystem;
@@ -75,15 +78,17 @@ struct Node {
   }
 };
 
-template<typename T>
+template<typename T, template<typename, bool = false> class VecT = MM_VEC>
 class DbscanMpi {
  public:
-  using DataT = MM_VEC<T>;
-  using TreeT = MM_VEC<std::unique_ptr<Node<T>>, true>;
-  using NodeT = MM_VEC<std::vector<Node<T>>, true>;
-  using AssignT = MM_VEC<size_t>;
-  using OutT = MM_VEC<int>;
-  using BoolT = MM_VEC<int>;
+  using DataT = VecT<T>;
+  using TreeT = VecT<std::unique_ptr<Node<T>>, true>;
+  using NodeT = VecT<std::vector<Node<T>>, true>;
+  using AssignT = VecT<size_t>;
+  using OutT = VecT<int>;
+  using BoolT = VecT<int>;
+  static_assert(mm::IsVectorBackendV<DataT>,
+                "DbscanMpi needs a vector backend");
 
  public:
   std::string dir_;
@@ -122,7 +127,13 @@ class DbscanMpi {
     path_ = path;
     max_depth_ = 16;
     // Create data vector
-    data_.Init(path, MM_READ_ONLY | MM_STAGE);
+    std::string ext = stdfs::path(path).extension();
+    if (ext == ".hdf5" || ext == ".h5") {
+      data_.Init(path, std::make_shared<mm::Hdf5Source<T>>(path),
+                 MM_READ_ONLY);
+    } else {
+      data_.Init(path, MM_READ_ONLY | MM_STAGE);
+    }
     data_.BoundMemory(window_size);
     data_.EvenPgas(rank_, nprocs_, data_.size());
     data_.Allocate();
@@ -130,11 +141,11 @@ class DbscanMpi {
     num_features_ = data_[0].GetNumFeatures();
     num_windows_ = data_.size() / window_size_elmt_;
     windows_per_proc_ = num_windows_ / nprocs_;
-    // Create tree vector
+    // Create tree vector (trees past the page size spill to an overflow)
     trees_.Init(dir_ + "/trees",
                 nprocs_,
                 KILOBYTES(512),
-                MM_WRITE_ONLY);
+                MM_WRITE_ONLY | MM_PACKED);
     trees_.BoundMemory(window_size_);
     trees_.EvenPgas(rank_, nprocs_, nprocs_);
     trees_.Allocate();
@@ -148,14 +159,13 @@ class DbscanMpi {
     sample.BoundMemory(window_size_);
     sample.EvenPgas(rank_, nprocs_, data_.size());
     sample.Allocate();
-    auto tx = sample.SeqTxBegin(data_.local_off(),
-                                data_.local_size(),
-                                MM_WRITE_ONLY);
+    sample.SeqTxBegin(data_.local_off(),
+                      data_.local_size(),
+                      MM_WRITE_ONLY);
     for (size_t i = 0; i < data_.local_size(); ++i) {
-      (*tx) = data_.local_off() + i;
-      ++tx;
+      sample[data_.local_off() + i] = data_.local_off() + i;
     }
-    sample.TxEnd(tx);
+    sample.TxEnd();
     sample.Barrier(MM_READ_ONLY, world_);
     return sample;
   }
@@ -166,9 +176,9 @@ class DbscanMpi {
     CreateDecisionTree(root, sample, 0,
                        MPI_COMM_WORLD, 0, nprocs_);
     HILOG(kInfo, "Created decision tree")
-    auto tx = trees_.SeqTxBegin(rank_, 1, MM_WRITE_ONLY);
-    (*tx) = std::move(root);
-    trees_.TxEnd(tx);
+    trees_.SeqTxBegin(rank_, 1, MM_WRITE_ONLY);
+    trees_[rank_] = std::move(root);
+    trees_.TxEnd();
     trees_.Barrier(MM_READ_ONLY, world_);
     std::unordered_set<T, T> joints = CombineDecisionTrees();
     Agglomerate(joints);
@@ -205,7 +215,8 @@ class DbscanMpi {
         hshm::Formatter::format("{}/sample_{}_{}",
                                 dir_, node->depth_ + 1,
                                 left_uuid);
-    left_sample.Init(left_sample_name, sample.size(), MM_APPEND_ONLY);
+    left_sample.Init(left_sample_name, sample.size(),
+                     MM_APPEND_ONLY | MM_SCAN_APPEND);
     left_sample.BoundMemory(window_size_);
     left_sample.Allocate();
     // Create right sample vec
@@ -215,7 +226,8 @@ class DbscanMpi {
         hshm::Formatter::format("{}/sample_{}_{}",
                                 dir_, node->depth_ + 1,
                                 right_uuid);
-    right_sample.Init(right_sample_name, sample.size(), MM_APPEND_ONLY);
+    right_sample.Init(right_sample_name, sample.size(),
+                      MM_APPEND_ONLY | MM_SCAN_APPEND);
     right_sample.BoundMemory(window_size_);
     right_sample.Allocate();
     // Partition the samples
@@ -413,16 +425,18 @@ class DbscanMpi {
                     AssignT &sample,
                     AssignT &left, AssignT &right,
                     MPI_Comm comm, int proc_off, int nprocs) {
-    for (size_t i = 0; i < sample.local_size(); ++i) {
-      size_t off = sample[sample.local_off() + i];
-      if (data_[off].LessThan(node.joint_, node.feature_)) {
-        left.emplace_back(off);
-      } else {
-        right.emplace_back(off);
+    mm::ForEachChunk(sample, 0, sample.size(), [&](size_t off, size_t size) {
+      for (size_t i = off; i < off + size; ++i) {
+        size_t idx = sample[i];
+        if (data_[idx].LessThan(node.joint_, node.feature_)) {
+          left.emplace_back(idx);
+        } else {
+          right.emplace_back(idx);
+        }
       }
-    }
-    // left.flush_emplace(comm, proc_off, nprocs);
-    // right.flush_emplace(comm, proc_off, nprocs);
+    }, comm);
+    left.FlushEmplace(comm);
+    right.FlushEmplace(comm);
   }
 
   std::unordered_set<T, T> CombineDecisionTrees() {
@@ -545,6 +559,9 @@ int main(int argc, char **argv) {
         algo, path, window_size, dist);
 
   if (algo == "mmap") {
+    DbscanMpi<Row, mm::VectorMmapMpi> dbscan;
+    dbscan.Init(MPI_COMM_WORLD, path, window_size, dist);
+    dbscan.Run();
   } else if (algo == "mega") {
     TRANSPARENT_HERMES();
     DbscanMpi<Row> dbscan;
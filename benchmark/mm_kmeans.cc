@@ -16,38 +16,11 @@
 #include "mega_mmap/vector_mmap_mpi.h"
 #include "test_types.h"
 #include "mega_mmap/vector_mega_mpi.h"
+#include "mega_mmap/vector_concept.h"
+#include "mega_mmap/source/arrow_source.h"
 
 namespace stdfs = std::filesystem;
 
-struct LocalMax {
-  size_t idx_;
-  double dist_;
-
-  LocalMax() : idx_(0), dist_(0) {}
-
-  LocalMax(size_t idx, double dist) : idx_(idx), dist_(dist) {}
-
-  LocalMax(const LocalMax &other) : idx_(other.idx_), dist_(other.dist_) {}
-
-  LocalMax &operator=(const LocalMax &other) {
-    idx_ = other.idx_;
-    dist_ = other.dist_;
-    return *this;
-  }
-
-  LocalMax &operator+=(const LocalMax &other) {
-    idx_ += other.idx_;
-    dist_ += other.dist_;
-    return *this;
-  }
-
-  LocalMax &operator/=(const size_t &other) {
-    idx_ /= other;
-    dist_ /= other;
-    return *this;
-  }
-};
-
 template<typename T>
 struct RowSum {
   T row_;
@@ -84,13 +57,18 @@ struct Center {
   }
 };
 
-template<typename T>
+/**
+ * KMeans over a vector backend (e.g., mm::VectorMegaMpi or
+ * mm::VectorMmapMpi) implementing mm::IsVectorBackend
+ * */
+template<typename T, template<typename, bool = false> class VecT = MM_VEC>
 class KMeans {
  public:
-  using DataT = MM_VEC<T>;
-  using MaxT = MM_VEC<LocalMax>;
-  using AssignT = MM_VEC<size_t>;
-  using SumT = MM_VEC<RowSum<T>>;
+  using DataT = VecT<T>;
+  using AssignT = VecT<size_t>;
+  using SumT = std::vector<RowSum<T>>;
+  static_assert(mm::IsVectorBackendV<DataT>,
+                "KMeans needs a vector backend");
 
  public:
   std::string dir_;
@@ -124,10 +102,16 @@ class KMeans {
     max_iter_ = max_iter;
 
 
-    data_.Init(path, MM_READ_ONLY | MM_STAGE);
+    if (stdfs::path(path).extension() == ".parquet") {
+      data_.Init(path, std::make_shared<mm::ParquetSource<T>>(
+          mm::ParquetSource<T>::Glob(path)), MM_READ_ONLY);
+    } else {
+      data_.Init(path, MM_READ_ONLY | MM_STAGE);
+    }
     data_.BoundMemory(window_size);
     data_.EvenPgas(rank_, nprocs_, data_.size());
     data_.Allocate();
+    data_.StageIn(world_);
     tol_ = tol;
     min_inertia_ = min_inertia;
   }
@@ -163,6 +147,7 @@ class KMeans {
   void Fit() {
     inertia_ = 1;
     for (iter_ = 0; iter_ < max_iter_; ++iter_) {
+      MM_SPAN("KMeansIteration", "app", iter_);
       HILOG(kInfo, "{}: On iteration {}", rank_, iter_)
       float cur_inertia = Assignment();
       if (cur_inertia <= min_inertia_) {
@@ -183,24 +168,17 @@ class KMeans {
   float Assignment() {
     // Initialize assign vector
     AssignT assign;
-    assign.Init(dir_ + "/" + "assign", data_.size(), MM_WRITE_ONLY);
+    assign.InitComm(world_, dir_ + "/" + "assign", data_.size(), MM_WRITE_ONLY);
     assign.BoundMemory(window_size_);
     assign.EvenPgas(rank_, nprocs_, data_.size());
     assign.Allocate();
 
-    // Initialize sum vector
-    SumT sum;
-    sum.Init(dir_ + "/" + "sum", nprocs_ * k_, MM_WRITE_ONLY);
-    sum.EvenPgas(rank_, nprocs_, nprocs_ * k_);
-    sum.Allocate();
+    // Initialize the local sums (reduced in memory, never stored)
+    SumT sum(k_);
 
     // Zero out sums
-    {
-      sum.SeqTxBegin(sum.local_off(), sum.local_size(), MM_WRITE_ONLY);
-      for (size_t i = 0; i < sum.local_size(); ++i) {
-        sum[i].Zero();
-      }
-      sum.TxEnd();
+    for (int i = 0; i < k_; ++i) {
+      sum[i].Zero();
     }
 
     // Calculate local assignment
@@ -208,9 +186,6 @@ class KMeans {
       data_.SeqTxBegin(data_.local_off(),
                        data_.local_size(),
                        MM_READ_ONLY);
-      sum.PgasTxBegin(sum.local_off(),
-                     sum.local_size(),
-                     MM_WRITE_ONLY);
       assign.SeqTxBegin(assign.local_off(),
                         assign.local_size(),
                         MM_WRITE_ONLY);
@@ -231,35 +206,30 @@ class KMeans {
             pow(row.Distance(ks_[assign_i].center_), 2);
       }
       data_.TxEnd();
-      sum.TxEnd();
       assign.TxEnd();
     }
     HILOG(kInfo, "{}: We are 100% done", rank_)
-    sum.Barrier(MM_READ_ONLY, world_);
+    // Combine the local sums of each process
+    auto add = [](const RowSum<T> &a, const RowSum<T> &b) {
+      RowSum<T> c = a;
+      c.row_ += b.row_;
+      c.count_ += b.count_;
+      c.inertia_ += b.inertia_;
+      return c;
+    };
+    mm::MpiReduce<RowSum<T>, decltype(add)>::AllReduce(
+        sum.data(), sum.size(), add, world_);
     // Calculate global statistics from each local assignment
     double inertia = 0;
-    {
-      sum.SeqTxBegin(0, sum.size(), MM_READ_ONLY);
-      for (int i = 0; i < ks_.size(); ++i) {
-        T avg(0);
-        size_t count = 0;
-        double k_inertia = 0;
-        for (int j = 0; j < nprocs_; ++j) {
-          RowSum<T> &sum_i = sum[j * k_ + i];
-          avg += sum_i.row_;
-          count += sum_i.count_;
-          k_inertia += sum_i.inertia_;
-        }
-        inertia += k_inertia;
-        avg /= count;
-        ks_[i].count_ = count;
-        ks_[i].inertia_ = k_inertia;
-        ks_[i].center_ = avg;
-      }
-      sum.TxEnd();
+    for (int i = 0; i < ks_.size(); ++i) {
+      RowSum<T> &sum_i = sum[i];
+      T avg = sum_i.row_;
+      inertia += sum_i.inertia_;
+      avg /= sum_i.count_;
+      ks_[i].count_ = sum_i.count_;
+      ks_[i].inertia_ = sum_i.inertia_;
+      ks_[i].center_ = avg;
     }
-    sum.Barrier(0, world_);
-    sum.Destroy();
     assign.Destroy();
     HILOG(kInfo, "Inertia {}: {}", rank_, inertia);
     return inertia;
@@ -297,26 +267,25 @@ class KMeans {
   }
 };
 
-template<typename T>
-class KMeansPpMpi : public KMeans<T> {
+template<typename T, template<typename, bool = false> class VecT = MM_VEC>
+class KMeansPpMpi : public KMeans<T, VecT> {
  public:
-  using DataT = MM_VEC<T>;
-  using MaxT = MM_VEC<LocalMax>;
-  using AssignT = MM_VEC<size_t>;
-  using SumT = MM_VEC<RowSum<T>>;
-  using KMeans<T>::dir_;
-  using KMeans<T>::rank_;
-  using KMeans<T>::ks_;
-  using KMeans<T>::k_;
-  using KMeans<T>::data_;
-  using KMeans<T>::nprocs_;
-  using KMeans<T>::window_size_;
-  using KMeans<T>::max_iter_;
-  using KMeans<T>::tol_;
-  using KMeans<T>::min_inertia_;
-  using KMeans<T>::Print;
-  using KMeans<T>::Fit;
-  using KMeans<T>::world_;
+  using DataT = VecT<T>;
+  using AssignT = VecT<size_t>;
+  using SumT = std::vector<RowSum<T>>;
+  using KMeans<T, VecT>::dir_;
+  using KMeans<T, VecT>::rank_;
+  using KMeans<T, VecT>::ks_;
+  using KMeans<T, VecT>::k_;
+  using KMeans<T, VecT>::data_;
+  using KMeans<T, VecT>::nprocs_;
+  using KMeans<T, VecT>::window_size_;
+  using KMeans<T, VecT>::max_iter_;
+  using KMeans<T, VecT>::tol_;
+  using KMeans<T, VecT>::min_inertia_;
+  using KMeans<T, VecT>::Print;
+  using KMeans<T, VecT>::Fit;
+  using KMeans<T, VecT>::world_;
 
  public:
   void Run() {
@@ -334,49 +303,14 @@ class KMeansPpMpi : public KMeans<T> {
   }
 
   /**
-   * Find the point that is furthest from all current centers.
+   * Find the point that is furthest from all current centers
+   * across all processes.
    * */
   void FindMax(std::vector<Center<T>> &ks) {
-    // Initialize local max vector
-    MaxT local_maxes;
-    local_maxes.Init(dir_ + "/" + "max", nprocs_, MM_WRITE_ONLY);
-    local_maxes.EvenPgas(rank_, nprocs_, nprocs_);
-    local_maxes.Allocate();
-    // Find point furthest away from all existing Ks
-    LocalMax local_max = FindLocalMax(ks);
-    // Wait for all processes to complete
-    {
-      local_maxes.SeqTxBegin(rank_, 1, MM_WRITE_ONLY);
-      local_maxes[rank_] = local_max;
-      local_maxes.TxEnd();
-    }
-    local_maxes.Barrier(MM_READ_ONLY, world_);
-    // Find global max across processes
-    LocalMax global_max = FindGlobalMax(local_maxes);
-    data_.SeqTxBegin(global_max.idx_, 1, MM_READ_ONLY);
-    ks.emplace_back(data_[global_max.idx_]);
-    data_.TxEnd();
-    // Clean up local maxes
-    local_maxes.Barrier(0, world_);
-    local_maxes.Destroy();
-  }
-
-  /**
-   * Find the point that is furthest from all current centers.
-   * This aggregates the local maximums discovered by all
-   * other procecsses.
-   * */
-  LocalMax FindGlobalMax(MaxT &local_maxes) {
-    LocalMax max;
-    local_maxes.SeqTxBegin(0, local_maxes.size(), MM_READ_ONLY);
-    for (int i = 0; i < nprocs_; ++i) {
-      LocalMax &cur_max = local_maxes[i];
-      if (cur_max.dist_ > max.dist_) {
-        max = cur_max;
-      }
-    }
-    local_maxes.TxEnd();
-    return max;
+    std::pair<size_t, T> max = data_.ArgMax(
+        data_.local_off(), data_.local_size(),
+        [&](T &pt) { return MinOfCenterDists(pt, ks); }, world_);
+    ks.emplace_back(max.second);
   }
 
   /**
@@ -399,33 +333,6 @@ class KMeansPpMpi : public KMeans<T> {
     return min_dist;
   }
 
-  /**
-   * Find the point furthest away from the current set of centers in the local
-   * branch of the dataset.
-   * */
-  LocalMax FindLocalMax(std::vector<Center<T>> &ks) {
-    LocalMax local_max;
-    size_t off = data_.local_off();
-    size_t last = data_.local_last();
-    data_.SeqTxBegin(off, last - off, MM_READ_ONLY);
-    size_t printer = (last - off) / 16;
-    for (size_t i = off; i < last; ++i) {
-      if ((i - off) % printer == 0) {
-        HILOG(kInfo, "{}: We are {}% done", rank_,
-              (i - off) * 100.0 / (last - off))
-      }
-      T &cur_pt = data_[i];
-      double dist = MinOfCenterDists(cur_pt, ks);
-      if (dist > local_max.dist_) {
-        local_max.dist_ = dist;
-        local_max.idx_ = i;
-      }
-    }
-    HILOG(kInfo, "{}: We are 100% done", rank_)
-    data_.TxEnd();
-    return local_max;
-  }
-
   /**
    * Select the first center to initialize kmeans++.
    * */
@@ -453,27 +360,26 @@ struct DataStat {
   }
 };
 
-template<typename T>
-class KmeansLlMpi : public KMeans<T> {
+template<typename T, template<typename, bool = false> class VecT = MM_VEC>
+class KmeansLlMpi : public KMeans<T, VecT> {
  public:
-  using CenterT = MM_VEC<T>;
-  using DataT = MM_VEC<T>;
-  using MaxT = MM_VEC<LocalMax>;
-  using AssignT = MM_VEC<size_t>;
-  using SumT = MM_VEC<RowSum<T>>;
-  using KMeans<T>::dir_;
-  using KMeans<T>::rank_;
-  using KMeans<T>::ks_;
-  using KMeans<T>::k_;
-  using KMeans<T>::data_;
-  using KMeans<T>::nprocs_;
-  using KMeans<T>::window_size_;
-  using KMeans<T>::max_iter_;
-  using KMeans<T>::tol_;
-  using KMeans<T>::min_inertia_;
-  using KMeans<T>::Print;
-  using KMeans<T>::Fit;
-  using KMeans<T>::world_;
+  using CenterT = VecT<T>;
+  using DataT = VecT<T>;
+  using AssignT = VecT<size_t>;
+  using SumT = std::vector<RowSum<T>>;
+  using KMeans<T, VecT>::dir_;
+  using KMeans<T, VecT>::rank_;
+  using KMeans<T, VecT>::ks_;
+  using KMeans<T, VecT>::k_;
+  using KMeans<T, VecT>::data_;
+  using KMeans<T, VecT>::nprocs_;
+  using KMeans<T, VecT>::window_size_;
+  using KMeans<T, VecT>::max_iter_;
+  using KMeans<T, VecT>::tol_;
+  using KMeans<T, VecT>::min_inertia_;
+  using KMeans<T, VecT>::Print;
+  using KMeans<T, VecT>::Fit;
+  using KMeans<T, VecT>::world_;
 
  public:
   void Run() {
@@ -497,7 +403,7 @@ class KmeansLlMpi : public KMeans<T> {
   void AggregateCenters(DataT &centers) {
     centers.Hint(MM_WRITE_ONLY);
     if (rank_ == 0) {
-      KMeansPpMpi<T> agg_kmeans;
+      KMeansPpMpi<T, VecT> agg_kmeans;
       agg_kmeans.Init(MPI_COMM_SELF,
                       centers,
                       window_size_,
@@ -534,8 +440,8 @@ class KmeansLlMpi : public KMeans<T> {
     HILOG(kInfo, "Selecting subclusters")
     // Initialize center vector
     DataT centers;
-    centers.Init(dir_ + "/" + "centers",
-                 nprocs_ * (l * count + 1), MM_WRITE_ONLY);
+    centers.InitComm(world_, dir_ + "/" + "centers",
+                 nprocs_ * (l * count + 1), MM_WRITE_ONLY | MM_NODE_SHARED);
     centers.EvenPgas(rank_, nprocs_, nprocs_ * (l * count + 1), l * count + 1);
     centers.Allocate();
 
@@ -704,13 +610,20 @@ int main(int argc, char **argv) {
         rank, algo, path, window_size, k, max_iter);
 
   if (algo == "mmap") {
+    KmeansLlMpi<Row, mm::VectorMmapMpi> kmeans;
+    kmeans.Init(MPI_COMM_WORLD, path, window_size, k, max_iter);
+    kmeans.Run();
+    MPI_Barrier(MPI_COMM_WORLD);
+    kmeans.Print();
   } else if (algo == "mega") {
     TRANSPARENT_HERMES();
+    MM_NODE_CACHE->Init(MPI_COMM_WORLD, window_size);
     KmeansLlMpi<Row> kmeans;
     kmeans.Init(MPI_COMM_WORLD, path, window_size, k, max_iter);
     kmeans.Run();
     MPI_Barrier(MPI_COMM_WORLD);
     kmeans.Print();
+    MM_NODE_CACHE->Finalize();
   } else {
     HILOG(kFatal, "Unknown algorithm: {}", algo);
   }
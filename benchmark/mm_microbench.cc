@@ -0,0 +1,356 @@
+#include <string>
+#include <mpi.h>
+#include <fstream>
+#include <vector>
+#include "hermes_shm/util/logging.h"
+#include "hermes_shm/util/config_parse.h"
+#include <filesystem>
+#include <algorithm>
+
+#include "mega_mmap/vector_mega_mpi.h"
+#include "test_types.h"
+
+namespace stdfs = std::filesystem;
+
+/** An element of a fixed size */
+template<size_t N>
+struct Elmt {
+  char data_[N];
+};
+
+/** The result of one benchmark of one configuration */
+struct BenchResult {
+  std::string bench_;   /**< The hot path measured */
+  size_t page_size_;    /**< Bytes per page */
+  size_t elmt_size_;    /**< Bytes per element */
+  double ratio_;        /**< Window size / dataset size */
+  size_t ops_;          /**< Operations per rank */
+  double secs_;         /**< Slowest rank's time */
+};
+
+/**
+ * Microbenchmarks of the VectorMegaMpi hot paths, each isolated on a
+ * private vector per rank:
+ * 1. hit: operator[] on the last accessed page
+ * 2. hit_map: operator[] alternating among resident pages
+ * 3. fault_sync / fault_async: page faults (Get vs AsyncGet)
+ * 4. evict_flush: flushing a dirty page and evicting it
+ * 5. emplace: emplace_back and FlushEmplace
+ * 6. tx_seq_write / tx_seq / tx_rand: accesses in transactions
+ * 7. accumulate: updates of a shared vector combined at their owners
+ * */
+template<size_t N>
+class MicroBench {
+ public:
+  using T = Elmt<N>;
+  using VecT = mm::VectorMegaMpi<T>;
+
+ public:
+  std::string dir_;
+  int rank_;
+  size_t count_;          /**< Elements in the dataset */
+  size_t window_size_;
+  size_t page_size_;
+  double ratio_;
+  std::vector<BenchResult> *results_;
+  volatile char sink_ = 0;  /**< Keeps reads from being optimized out */
+
+ public:
+  void Run(const std::string &dir, size_t data_size, size_t page_size,
+           double ratio, std::vector<BenchResult> &results) {
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+    dir_ = dir;
+    count_ = std::max<size_t>(data_size / sizeof(T), 1);
+    page_size_ = page_size;
+    ratio_ = ratio;
+    window_size_ = (size_t)(data_size * ratio);
+    results_ = &results;
+    VecT vec;
+    Open(vec, "data", MM_READ_WRITE);
+    Fill(vec);
+    Hit(vec);
+    HitMap(vec);
+    FaultSync(vec);
+    FaultAsync(vec);
+    EvictFlush(vec);
+    TxSeq(vec);
+    TxRand(vec);
+    vec.Destroy();
+    Emplace();
+    Accumulate();
+  }
+
+  /** Create a private vector of the dataset size */
+  void Open(VecT &vec, const std::string &name, u32 flags) {
+    vec.InitComm(MPI_COMM_SELF,
+             hshm::Formatter::format("{}/microbench_{}_{}",
+                                     dir_, name, rank_),
+             count_, flags);
+    vec.SetPageSize(page_size_);
+    vec.BoundMemory(window_size_);
+    vec.Allocate();
+  }
+
+  /** Time fn, which performs ops operations, on every rank */
+  template<typename F>
+  void Time(const std::string &bench, size_t ops, F &&fn) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    fn();
+    Record(bench, ops, MPI_Wtime() - start);
+  }
+
+  /** Record the time of the slowest rank */
+  void Record(const std::string &bench, size_t ops, double secs) {
+    MPI_Allreduce(MPI_IN_PLACE, &secs, 1, MPI_DOUBLE, MPI_MAX,
+                  MPI_COMM_WORLD);
+    results_->emplace_back(BenchResult{bench, page_size_, sizeof(T),
+                                       ratio_, ops, secs});
+  }
+
+  /** Flush and evict every resident page */
+  void EvictAll(VecT &vec) {
+    std::vector<size_t> pages;
+    for (auto &[page_idx, page] : vec.data_) {
+      pages.emplace_back(page_idx);
+    }
+    for (size_t page_idx : pages) {
+      vec.Rescore(page_idx, 0, vec.elmts_per_page_, 0,
+                  bitfield32_t(MM_READ_WRITE));
+    }
+  }
+
+  /** Number of pages in the dataset */
+  size_t NumPages(VecT &vec) {
+    return (count_ + vec.elmts_per_page_ - 1) / vec.elmts_per_page_;
+  }
+
+  /** Pages which fit in the window (at least one) */
+  size_t WindowPages(VecT &vec) {
+    return std::max<size_t>(window_size_ / vec.page_size_, 1);
+  }
+
+  /** Write every element, so each page exists in the backend */
+  void Fill(VecT &vec) {
+    Time("tx_seq_write", count_, [&]() {
+      vec.SeqTxBegin(0, count_, MM_WRITE_ONLY);
+      for (size_t i = 0; i < count_; ++i) {
+        vec[i].data_[0] = (char)i;
+      }
+      vec.TxEnd();
+    });
+    EvictAll(vec);
+  }
+
+  /** Accesses to the page accessed last */
+  void Hit(VecT &vec) {
+    size_t ops = count_;
+    size_t epp = std::min(vec.elmts_per_page_, count_);
+    vec.Read(0);
+    Time("hit", ops, [&]() {
+      for (size_t i = 0; i < ops; ++i) {
+        sink_ += vec.Read(i % epp).data_[0];
+      }
+    });
+    EvictAll(vec);
+  }
+
+  /** Accesses alternating among resident pages (page table lookups) */
+  void HitMap(VecT &vec) {
+    size_t pages = std::min<size_t>(
+        std::min(WindowPages(vec), NumPages(vec)), 16);
+    for (size_t p = 0; p < pages; ++p) {
+      vec.Read(p * vec.elmts_per_page_);
+    }
+    size_t ops = count_;
+    Time("hit_map", ops, [&]() {
+      for (size_t i = 0; i < ops; ++i) {
+        size_t page_idx = i % pages;
+        sink_ += vec.Read(page_idx * vec.elmts_per_page_).data_[0];
+      }
+    });
+    EvictAll(vec);
+  }
+
+  /** Synchronous faults of every page, evicting each after its fault */
+  void FaultSync(VecT &vec) {
+    size_t pages = NumPages(vec);
+    double secs = 0;
+    for (size_t p = 0; p < pages; ++p) {
+      double start = MPI_Wtime();
+      vec.template _Fault<false>(p);
+      secs += MPI_Wtime() - start;
+      vec._Evict(p);
+    }
+    Record("fault_sync", pages, secs);
+  }
+
+  /** Asynchronous faults issued a window of pages at a time */
+  void FaultAsync(VecT &vec) {
+    size_t pages = NumPages(vec);
+    size_t batch = WindowPages(vec);
+    Time("fault_async", pages, [&]() {
+      for (size_t p = 0; p < pages; p += batch) {
+        size_t last = std::min(p + batch, pages);
+        for (size_t i = p; i < last; ++i) {
+          vec.template _Fault<true>(i);
+        }
+        for (size_t i = p; i < last; ++i) {
+          vec.template FinishAsyncFault<false>(vec.data_[i]);
+        }
+        for (size_t i = p; i < last; ++i) {
+          vec._Evict(i);
+        }
+      }
+    });
+  }
+
+  /** Flush and evict pages with one modified element */
+  void EvictFlush(VecT &vec) {
+    size_t pages = NumPages(vec);
+    double secs = 0;
+    for (size_t p = 0; p < pages; ++p) {
+      vec.Write(p * vec.elmts_per_page_).data_[0] += 1;
+      double start = MPI_Wtime();
+      vec.Rescore(p, 0, vec.elmts_per_page_, 0,
+                  bitfield32_t(MM_READ_WRITE));
+      secs += MPI_Wtime() - start;
+    }
+    Record("evict_flush", pages, secs);
+  }
+
+  /** Reads in a sequential transaction (faults bounded by the window) */
+  void TxSeq(VecT &vec) {
+    Time("tx_seq", count_, [&]() {
+      vec.SeqTxBegin(0, count_, MM_READ_ONLY);
+      for (size_t i = 0; i < count_; ++i) {
+        sink_ += vec[i].data_[0];
+      }
+      vec.TxEnd();
+    });
+    EvictAll(vec);
+  }
+
+  /** Reads in a random transaction */
+  void TxRand(VecT &vec) {
+    Time("tx_rand", count_, [&]() {
+      vec.RandTxBegin(SEED, 0, count_, count_, MM_READ_ONLY);
+      for (size_t i = 0; i < count_; ++i) {
+        sink_ += vec.template TxGet<mm::RandIterTx>().data_[0];
+      }
+      vec.TxEnd();
+    });
+    EvictAll(vec);
+  }
+
+  /** Appends of a dataset to an empty vector */
+  void Emplace() {
+    VecT vec;
+    Open(vec, "append", MM_APPEND_ONLY);
+    T elmt{};
+    Time("emplace", count_, [&]() {
+      for (size_t i = 0; i < count_; ++i) {
+        vec.emplace_back(elmt);
+      }
+      vec.FlushEmplace(MPI_COMM_SELF);
+    });
+    vec.Destroy();
+  }
+
+  /**
+   * Updates scattered over a vector shared by every rank, combined at
+   * their owners (MM_ACCUMULATE). The time includes shipping them.
+   * */
+  void Accumulate() {
+    int nprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    size_t total = count_ * nprocs;
+    VecT vec;
+    vec.InitComm(MPI_COMM_WORLD,
+                 hshm::Formatter::format("{}/microbench_accumulate", dir_),
+                 total, MM_WRITE_ONLY | MM_ACCUMULATE);
+    vec.SetPageSize(page_size_);
+    vec.BoundMemory(window_size_);
+    vec.EvenPgas(total);
+    vec.Allocate();
+    auto add = [](const T &a, const T &b) {
+      T c = a;
+      c.data_[0] += b.data_[0];
+      return c;
+    };
+    T one{};
+    one.data_[0] = 1;
+    Time("accumulate", count_, [&]() {
+      for (size_t i = 0; i < count_; ++i) {
+        vec.Accumulate((i * 2654435761ull + rank_) % total, one, add);
+      }
+      vec.Barrier(MM_READ_ONLY);
+    });
+    vec.Destroy();
+  }
+};
+
+/**
+ * Write the results in the column format of the jarvis pipeline CSVs
+ * consumed by analysis/
+ * */
+void WriteCsv(const std::string &path, int nprocs,
+              const std::vector<BenchResult> &results) {
+  std::ofstream out(path);
+  out << "mm_microbench.bench,mm_microbench.page_size,"
+         "mm_microbench.elmt_size,mm_microbench.window_ratio,"
+         "mm_microbench.nprocs,mm_microbench.ops,"
+         "mm_microbench.runtime,mm_microbench.ns_per_op\n";
+  for (const BenchResult &res : results) {
+    double ns_per_op = res.ops_ ? res.secs_ * 1e9 / res.ops_ : 0;
+    out << res.bench_ << "," << res.page_size_ << ","
+        << res.elmt_size_ << "," << res.ratio_ << ","
+        << nprocs << "," << res.ops_ << ","
+        << res.secs_ << "," << ns_per_op << "\n";
+  }
+}
+
+/** Run every benchmark for one element size */
+template<size_t N>
+void Sweep(const std::string &dir, size_t data_size,
+           const std::vector<size_t> &page_sizes,
+           const std::vector<double> &ratios,
+           std::vector<BenchResult> &results) {
+  for (size_t page_size : page_sizes) {
+    for (double ratio : ratios) {
+      HILOG(kInfo, "Element size {}, page size {}, window ratio {}",
+            N, page_size, ratio);
+      MicroBench<N> bench;
+      bench.Run(dir, data_size, page_size, ratio, results);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  if (argc != 4) {
+    HILOG(kFatal, "USAGE: ./mm_microbench [dir] [data_size] [csv_path]");
+  }
+  int rank, nprocs;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  std::string dir = argv[1];
+  size_t data_size = hshm::ConfigParse::ParseSize(argv[2]);
+  std::string csv_path = argv[3];
+  HILOG(kInfo, "{}: Running microbenchmarks in {} with {} bytes per rank",
+        rank, dir, data_size);
+
+  TRANSPARENT_HERMES();
+  std::vector<size_t> page_sizes = {
+      KILOBYTES(64), MEGABYTES(1), MEGABYTES(4)};
+  std::vector<double> ratios = {.25, .5, 1};
+  std::vector<BenchResult> results;
+  Sweep<8>(dir, data_size, page_sizes, ratios, results);
+  Sweep<64>(dir, data_size, page_sizes, ratios, results);
+  Sweep<512>(dir, data_size, page_sizes, ratios, results);
+  if (rank == 0) {
+    WriteCsv(csv_path, nprocs, results);
+    HILOG(kInfo, "Wrote {} results to {}", results.size(), csv_path);
+  }
+  MPI_Finalize();
+}
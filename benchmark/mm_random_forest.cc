@@ -11,10 +11,15 @@
 #include "hermes_shm/util/random.h"
 #include <filesystem>
 #include <algorithm>
+#include <type_traits>
 
 #include "mega_mmap/vector_mmap_mpi.h"
 #include "test_types.h"
+#include "flat_tree.h"
 #include "mega_mmap/vector_mega_mpi.h"
+#include "mega_mmap/vector_columnar_mpi.h"
+#include "mega_mmap/scheduler.h"
+#include "mega_mmap/vector_concept.h"
 
 namespace stdfs = std::filesystem;
 
@@ -83,19 +88,26 @@ struct Node {
  * 4.
  * */
 
-template<typename T>
+template<typename T, template<typename, bool = false> class VecT = MM_VEC>
 class RandomForestClassifierMpi {
  public:
-  using DataT = MM_VEC<T>;
-  using TreeT = MM_VEC<std::unique_ptr<Node<T>>, true>;
+  using DataT = VecT<T>;
+  using TreeT = VecT<std::unique_ptr<Node<T>>, true>;
+  using FlatT = VecT<FlatNode<T>>;
   using GiniT = Gini<T>;
-  using AssignT = MM_VEC<size_t>;
+  using AssignT = VecT<size_t>;
+  using ColsT = mm::VectorColumnarMpi<T>;
+  static_assert(mm::IsVectorBackendV<DataT>,
+                "RandomForestClassifierMpi needs a vector backend");
 
  public:
   std::string dir_;
   DataT data_;
   DataT test_data_;
-  TreeT trees_;
+  ColsT data_cols_;          /**< Columns of data_ for scoring splits */
+  bool columnar_ = false;
+  FlatT forest_;             /**< The nodes of every tree */
+  std::vector<u64> roots_;   /**< The root of each tree in forest_ */
   int rank_;
   int nprocs_;
   size_t window_size_;
@@ -121,7 +133,8 @@ class RandomForestClassifierMpi {
             size_t window_size,
             int num_trees = 4,
             float tol = .0001,
-            int max_depth = 5){
+            int max_depth = 5,
+            bool columnar = false){
     world_ = world;
     MPI_Comm_rank(world_, &rank_);
     MPI_Comm_size(world_, &nprocs_);
@@ -137,6 +150,24 @@ class RandomForestClassifierMpi {
     data_.BoundMemory(window_size_);
     data_.EvenPgas(rank_, nprocs_, data_.size());
     data_.Allocate();
+    data_.StageIn(world_);
+    columnar_ = columnar;
+    if constexpr (std::is_same_v<DataT, mm::VectorMegaMpi<T>>) {
+      // Samples draw rows of every partition: read them from the owners
+      data_.EnableRma(world_);
+      data_.Barrier(MM_READ_ONLY, world_);
+      // Score root splits over columns, so only the sampled features are read
+      if (columnar_) {
+        data_cols_.Init(dir_ + "/train_cols", data_.size(), MM_READ_WRITE);
+        data_cols_.BoundMemory(window_size_);
+        data_cols_.EvenPgas(rank_, nprocs_, data_.size());
+        data_cols_.Allocate();
+        data_cols_.Import(data_);
+        data_cols_.Barrier(MM_READ_ONLY, world_);
+      }
+    } else if (columnar) {
+      HELOG(kFatal, "Columnar splits need the mega backend");
+    }
     // Load test data and partition
     test_data_.Init(test_path, MM_READ_ONLY | MM_STAGE);
     test_data_.BoundMemory(window_size_);
@@ -147,11 +178,6 @@ class RandomForestClassifierMpi {
     windows_per_proc_ = num_windows_ / nprocs_;
     // Initialize final tree data structure
     num_trees_ = num_trees;
-    trees_.Init(dir_ + "/trees",
-                num_trees_ ,
-                KILOBYTES(256),
-                MM_WRITE_ONLY);
-    trees_.Allocate();
     // Initialize RNG
     feature_dist_.Seed(SEED);
     feature_dist_.Shape(0, num_features_ - 1);
@@ -159,34 +185,48 @@ class RandomForestClassifierMpi {
 
   void Run() {
     HILOG(kInfo, "Running random forest on rank {}", rank_);
-    if (rank_ == 0) {
-      trees_.PgasTxBegin(0,
-                         num_trees_, MM_WRITE_ONLY);
-    }
+    std::vector<FlatNode<T>> flat;
+    roots_.resize(num_trees_);
     for (int i = 0; i < num_trees_; ++i) {
       HILOG(kInfo, "Creating tree {} on rank {}", i, rank_);
       std::unique_ptr<Node<T>> root = std::make_unique<Node<T>>();
-      CreateDecisionTree(root, nullptr, data_, 0,
+      CreateDecisionTree(root, nullptr, data_,
+                         columnar_ ? &data_cols_ : nullptr, 0,
                          MPI_COMM_WORLD,
                          rank_, nprocs_);
-      if (rank_ == 0) {
-        trees_[i] = std::move(root);
-      }
+      roots_[i] = FlatTree<T>::Flatten(*root, flat);
     }
-    if (rank_ == 0) {
-      trees_.TxEnd();
+    if (columnar_) {
+      data_cols_.Destroy();
     }
-    trees_.Barrier(MM_READ_ONLY, world_);
+    StoreForest(flat);
     float error = Predict(test_data_);
     if (rank_ == 0) {
       HILOG(kInfo, "Prediction Accuracy: {}", 1 - error);
     }
   }
 
+  /**
+   * Store the flattened trees of rank 0 in forest_, so prediction
+   * reads nodes in place from pages instead of deserializing trees
+   * */
+  void StoreForest(const std::vector<FlatNode<T>> &flat) {
+    u64 count = flat.size();
+    MPI_Bcast(&count, 1, MPI_UINT64_T, 0, world_);
+    MPI_Bcast(roots_.data(), num_trees_, MPI_UINT64_T, 0, world_);
+    forest_.Init(dir_ + "/forest", count, MM_WRITE_ONLY);
+    forest_.Allocate();
+    if (rank_ == 0) {
+      forest_.SeqTxBegin(0, count, MM_WRITE_ONLY);
+      for (size_t i = 0; i < count; ++i) {
+        forest_[i] = flat[i];
+      }
+      forest_.TxEnd();
+    }
+    forest_.Barrier(MM_READ_ONLY, world_);
+  }
+
   float Predict(DataT &data) {
-    AssignT preds;
-    preds.Init(dir_ + "/preds", nprocs_, MM_WRITE_ONLY);
-    preds.EvenPgas(rank_, nprocs_, data.size());
     size_t err_count = 0;
     // Get the offset and size of data to predict
     size_t size_pp = test_data_.size() / nprocs_;
@@ -196,12 +236,9 @@ class RandomForestClassifierMpi {
     }
     // Predict and calculate classification error
     PredictLocal(data, off, size_pp, err_count);
-    preds[rank_] = err_count;
-    preds.Barrier(MM_READ_ONLY, world_);
-    float err = 0;
-    for (int i = 0; i < nprocs_; ++i) {
-      err += preds[i];
-    }
+    MPI_Allreduce(MPI_IN_PLACE, &err_count, 1, MPI_UINT64_T, MPI_SUM,
+                  world_);
+    float err = err_count;
     return err / data.size();
   }
 
@@ -212,9 +249,8 @@ class RandomForestClassifierMpi {
     for (size_t i = off; i < size; ++i) {
       T &row = data[i];
       std::unordered_map<float, int> rows;
-      for (int i = 0; i < trees_.size(); ++i) {
-        std::unique_ptr<Node<T>> &tree = trees_[i];
-        T pred = tree->Predict(row);
+      for (int i = 0; i < num_trees_; ++i) {
+        T pred = FlatTree<T>::Predict(forest_, roots_[i], row);
         if (rows.find(pred.last()) == rows.end()) {
           rows[pred.last()] = 0;
         }
@@ -247,9 +283,14 @@ class RandomForestClassifierMpi {
     return subsample_size;
   }
 
+  /**
+   * Grow the tree below node from sample. If cols is set, it holds
+   * the columns of sample, which are used to score the splits.
+   * */
   void CreateDecisionTree(std::unique_ptr<Node<T>> &node,
                           const std::unique_ptr<Node<T>> &parent,
                           DataT &sample,
+                          ColsT *cols,
                           uint64_t uuid,
                           MPI_Comm comm, int rank, int nprocs) {
     HILOG(kInfo, "Creating decision tree on rank {} with {} samples",
@@ -260,21 +301,18 @@ class RandomForestClassifierMpi {
     for (int i = 0; i < num_bootstrap_samples_; ++i) {
       std::vector<int> features = SubsampleFeatures();
       size_t subsample_size = SubsampleSize(sample);
-      sample.RandTxBegin(SEED, 0,  sample.size(),
-                         (subsample_size + 1) * features.size(),
-                         MM_READ_ONLY);
-      for (int feature : features) {
-        stats[stat_idx] = *node;
-        stats[stat_idx].feature_ = feature;
-        stats[stat_idx].joint_ = sample.template TxGet<mm::RandIterTx>();
-        stats[stat_idx].left_ = std::make_unique<Node<T>>();
-        stats[stat_idx].right_ = std::make_unique<Node<T>>();
-        Split(stats[stat_idx], sample,  subsample_size,
-              feature, stats[stat_idx].joint_, uuid,
-              comm, rank, nprocs);
-        ++stat_idx;
+      if (cols) {
+        // Only the sampled features and the label are paged in
+        u64 mask = ColsT::ColMask(ColsT::kNumCols - 1);
+        for (int feature : features) {
+          mask |= ColsT::ColMask(feature);
+        }
+        SplitFeatures(*node, stats, stat_idx, *cols, features,
+                      subsample_size, uuid, comm, rank, nprocs, mask);
+      } else {
+        SplitFeatures(*node, stats, stat_idx, sample, features,
+                      subsample_size, uuid, comm, rank, nprocs);
       }
-      sample.TxEnd();
     }
     auto it = std::min_element(stats.begin(), stats.end(),
                                [](const Node<T> &a, const Node<T> &b) {
@@ -307,12 +345,14 @@ class RandomForestClassifierMpi {
         hshm::Formatter::format("{}/sample_{}_{}",
                                 dir_, node->depth_ + 1,
                                 right_uuid);
-    left_sample.Init(left_sample_name,
-                     node->left_->count_, MM_APPEND_ONLY);
+    left_sample.InitComm(comm, left_sample_name,
+                     node->left_->count_,
+                     MM_APPEND_ONLY | MM_SCAN_APPEND);
     left_sample.BoundMemory(window_size_);
     left_sample.Allocate();
-    right_sample.Init(right_sample_name,
-                      node->right_->count_, MM_APPEND_ONLY);
+    right_sample.InitComm(comm, right_sample_name,
+                      node->right_->count_,
+                      MM_APPEND_ONLY | MM_SCAN_APPEND);
     right_sample.BoundMemory(window_size_);
     right_sample.Allocate();
     DivideSample(*node, sample,
@@ -323,57 +363,74 @@ class RandomForestClassifierMpi {
     HILOG(kInfo, "Finished decision tree on rank {} with {} samples, {} and {}",
           rank_, sample.size(), left_sample.size(), right_sample.size());
 
-    // Create next decision tree nodes
-    int left_off = rank;
-    int left_proc = nprocs / 2;
-    int right_off = rank + left_proc;
-    int right_proc = nprocs - left_proc;
-    if (right_proc < 1) {
-      right_off = rank;
-      right_proc = 1;
-    }
-    if (left_proc < 1) {
-      left_off = rank;
-      left_proc = 1;
-    }
-//    MpiComm left_subcomm(comm, left_off, left_proc);
-//    MpiComm right_subcomm(comm, right_off, right_proc);
+    // Create next decision tree nodes (every rank of comm builds both,
+    // so each rank ends up with the whole tree)
     CreateDecisionTree(node->left_, node,
-                       left_sample,
+                       left_sample, nullptr,
                        left_uuid,
                        comm, rank, nprocs);
     CreateDecisionTree(node->right_, node,
-                       right_sample,
+                       right_sample, nullptr,
                        right_uuid,
                        comm, rank, nprocs);
   }
 
+  /**
+   * Score a split on each feature over one random subsample of sample.
+   * cols are the extra arguments of RandTxBegin (e.g., a column mask).
+   * */
+  template<typename SampleT, typename ...Cols>
+  void SplitFeatures(Node<T> &node,
+                     std::vector<Node<T>> &stats,
+                     size_t &stat_idx,
+                     SampleT &sample,
+                     const std::vector<int> &features,
+                     size_t subsample_size,
+                     uint64_t uuid,
+                     MPI_Comm comm, int rank, int nprocs,
+                     Cols ...cols) {
+    sample.RandTxBegin(SEED, 0,  sample.size(),
+                       (subsample_size + 1) * features.size(),
+                       MM_READ_ONLY, cols...);
+    for (int feature : features) {
+      stats[stat_idx] = node;
+      stats[stat_idx].feature_ = feature;
+      stats[stat_idx].joint_ = sample.template TxGet<mm::RandIterTx>();
+      stats[stat_idx].left_ = std::make_unique<Node<T>>();
+      stats[stat_idx].right_ = std::make_unique<Node<T>>();
+      Split(stats[stat_idx], sample,  subsample_size,
+            feature, stats[stat_idx].joint_, uuid,
+            comm, rank, nprocs);
+      ++stat_idx;
+    }
+    sample.TxEnd();
+  }
+
   void DivideSample(Node<T> &node,
                     DataT &sample,
                     DataT &left,
                     DataT &right,
                     MPI_Comm comm, int rank, int nprocs) {
-    sample.EvenPgas(rank, nprocs, sample.size());
-    sample.SeqTxBegin(sample.local_off(), sample.local_size(),
-                      MM_READ_ONLY);
-    HILOG(kInfo, "{}: Dividing sample of size {}", rank, sample.local_size());
-    for (size_t i = sample.local_off(); i < sample.local_size(); ++i) {
-      T &elmt = sample[i];
-      if (elmt.LessThan(node.joint_, node.feature_)) {
-        left.emplace_back(elmt);
-      } else {
-        right.emplace_back(elmt);
+    HILOG(kInfo, "{}: Dividing sample of size {}", rank, sample.size());
+    mm::ForEachChunk(sample, 0, sample.size(), [&](size_t off, size_t size) {
+      for (size_t i = off; i < off + size; ++i) {
+        T &elmt = sample[i];
+        if (elmt.LessThan(node.joint_, node.feature_)) {
+          left.emplace_back(elmt);
+        } else {
+          right.emplace_back(elmt);
+        }
       }
-    }
-    sample.TxEnd();
-    left.FlushEmplace(comm);
-    right.FlushEmplace(comm);
+    }, comm);
+    left.FlushEmplace();
+    right.FlushEmplace();
     left.Hint(MM_READ_ONLY);
     right.Hint(MM_READ_ONLY);
   }
 
+  template<typename SampleT>
   void Split(Node<T> &node,
-             DataT &sample,
+             SampleT &sample,
              size_t subsample_size,
              int feature,
              T &joint,
@@ -383,10 +440,10 @@ class RandomForestClassifierMpi {
     // Calculate the entropy per-node
     std::string nodes_name = hshm::Formatter::format(dir_ + "/nodes_{}_{}",
                                                      node.depth_, uuid);
-    nodes.Init(nodes_name,
+    nodes.InitComm(comm, nodes_name,
                nprocs, MM_WRITE_ONLY);
     HILOG(kInfo, "{}: Created {} for {} procs", rank_, nodes_name, nprocs);
-    nodes.EvenPgas(rank, nprocs, nprocs);
+    nodes.EvenPgas(nprocs);
     nodes.Allocate();
     nodes.PgasTxBegin(rank, 1, MM_WRITE_ONLY);
     nodes[rank] = std::make_unique<Node<T>>();
@@ -394,7 +451,7 @@ class RandomForestClassifierMpi {
     nodes[rank]->right_ = std::make_unique<Node<T>>();
     LocalSplit(*nodes[rank], sample, subsample_size, feature, joint);
     nodes.TxEnd();
-    nodes.Barrier(MM_READ_ONLY, comm);
+    nodes.Barrier(MM_READ_ONLY);
 
     // Sum up node entropies
     nodes.SeqTxBegin(0, nprocs, MM_READ_ONLY);
@@ -405,7 +462,7 @@ class RandomForestClassifierMpi {
       node.right_->count_ += onode.right_->count_;
     }
     nodes.TxEnd();
-    nodes.Barrier(MM_READ_ONLY, comm);
+    nodes.Barrier(MM_READ_ONLY);
     // nodes.Destroy();
   }
 
@@ -433,13 +490,37 @@ class RandomForestClassifierMpi {
     node.right_->count_ = count[1];
     node.entropy_ = gini.Get();
   }
+
+  /** LocalSplit over the columns of the current transaction */
+  void LocalSplit(Node<T> &node,
+                  ColsT &sample,
+                  size_t subsample_size,
+                  int feature,
+                  T &joint) {
+    GiniT gini;
+    size_t count[2] = {0};
+    for (size_t i = 0 ; i < subsample_size; ++i) {
+      T row = sample.template TxGet<mm::RandIterTx>().Get(sample.tx_cols_);
+      if (row.LessThan(joint, feature)) {
+        count[0] += 1;
+        gini.Induct(row, 0);
+      } else {
+        count[1] += 1;
+        gini.Induct(row, 1);
+      }
+    }
+    node.left_->count_ = count[0];
+    node.right_->count_ = count[1];
+    node.entropy_ = gini.Get();
+  }
 };
 
 int main(int argc, char **argv) {
   MPI_Init(&argc, &argv);
   if (argc != 6) {
     HILOG(kFatal, "USAGE: ./mm_random_forest [algo] [train_path] [test_path] "
-                  "[nfeature] [window_size]");
+                  "[nfeature] [window_size]\n"
+                  "algo: mmap, mega, or mega_col (splits over columns)");
   }
   int rank, nprocs;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -454,12 +535,18 @@ int main(int argc, char **argv) {
   HILOG(kInfo, "Parsed argument on {}", rank);
 
   if (algo == "mmap") {
-  } else if (algo == "mega") {
+    RandomForestClassifierMpi<ClassRow, mm::VectorMmapMpi> rf;
+    rf.Init(MPI_COMM_WORLD,
+            train_path, test_path,
+            nfeature, ncol, window_size);
+    rf.Run();
+  } else if (algo == "mega" || algo == "mega_col") {
     TRANSPARENT_HERMES();
     RandomForestClassifierMpi<ClassRow> rf;
     rf.Init(MPI_COMM_WORLD,
             train_path, test_path,
-            nfeature, ncol, window_size);
+            nfeature, ncol, window_size,
+            4, .0001, 5, algo == "mega_col");
     rf.Run();
   } else {
     HILOG(kFatal, "Unknown algorithm: {}", algo);
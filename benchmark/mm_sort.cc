@@ -10,65 +10,627 @@
 #include "hermes_shm/util/config_parse.h"
 #include <filesystem>
 #include <algorithm>
+#include <queue>
 #include <mega_mmap/vector_mmap_mpi.h>
+#include <mega_mmap/vector_mega_mpi.h>
+#include <mega_mmap/parallel_sort.h>
 
 namespace stdfs = std::filesystem;
 
+/**
+ * Check that the range [off, off + size) of each rank is sorted, and
+ * that the ranges of consecutive ranks are in order (collective)
+ * */
 template<typename VecT, typename T>
-class BigSortMpi {
+bool VerifySorted(VecT &vec, size_t off, size_t size, MPI_Comm comm) {
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  bool is_sorted = true;
+  T first{}, last{};
+  if (size) {
+    vec.SeqTxBegin(off, size, MM_READ_ONLY);
+    first = vec[off];
+    last = first;
+    for (size_t i = off + 1; i < off + size; ++i) {
+      T &elmt = vec[i];
+      is_sorted &= !(elmt < last);
+      last = elmt;
+    }
+    vec.TxEnd();
+  }
+  // The last element of a rank must not exceed the next rank's first
+  std::vector<T> firsts(nprocs), lasts(nprocs);
+  std::vector<int> sizes(nprocs);
+  int has_elmts = size > 0;
+  MPI_Allgather(&first, sizeof(T), MPI_BYTE, firsts.data(),
+                sizeof(T), MPI_BYTE, comm);
+  MPI_Allgather(&last, sizeof(T), MPI_BYTE, lasts.data(),
+                sizeof(T), MPI_BYTE, comm);
+  MPI_Allgather(&has_elmts, 1, MPI_INT, sizes.data(), 1, MPI_INT, comm);
+  bool have_prior = false;
+  T prior{};
+  for (int i = 0; i < nprocs; ++i) {
+    if (!sizes[i]) {
+      continue;
+    }
+    is_sorted &= !have_prior || !(firsts[i] < prior);
+    prior = lasts[i];
+    have_prior = true;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &is_sorted, 1, MPI_C_BOOL,
+                MPI_LAND, comm);
+  return is_sorted;
+}
+
+/**
+ * Out-of-core distributed merge sort over VectorMmapMpi, in a number
+ * of passes over the file fixed by its size and the window.
+ *
+ * 1. Each rank reads window-sized runs of its partition, sorts them
+ * with OpenMP threads, and writes them sequentially.
+ * 2. While the runs of all ranks exceed the merge fan-in (the buffers
+ * which fit in the window), each rank k-way merges groups of its runs.
+ * 3. Splitters sampled from the runs give each rank a range of values.
+ * Each rank finds its range in every run by binary search, and k-way
+ * merges the pieces into its part of the output.
+ *
+ * Passes ping-pong between the file and a temporary file, starting
+ * such that the last pass writes the file. Runs are streamed with
+ * sequential transactions (MADV_SEQUENTIAL, released behind the cursor).
+ * */
+template<typename T>
+class MmapSortMpi {
  public:
-  VecT vec_;
+  using VecT = mm::VectorMmapMpi<T>;
+
+  /** A sorted run being merged */
+  struct Run {
+    size_t off_;           /**< Next element to read */
+    size_t end_;           /**< One past the last element of the run */
+    std::vector<T> buf_;   /**< Elements read from the run */
+    size_t pos_ = 0;       /**< Next element of buf_ */
+  };
 
  public:
-  void Sort(const std::string &path, int rank, int nprocs,
-            size_t window_size) {
-    vec_.Init(path);
-    size_t data_size = vec_.size_;
-    size_t shift = window_size / 2;
-    size_t proc_size = data_size / nprocs;
-    size_t proc_off = rank * proc_size;
-    while (true) {
-      bool left_sorted = SmallSort(rank, proc_off,
-                                   shift, proc_size,
-                                   window_size, data_size);
-      MPI_Barrier(MPI_COMM_WORLD);
-      bool right_sorted = SmallSort(rank, proc_off + shift,
-                                    shift, proc_size,
-                                    window_size, data_size);
-      MPI_Barrier(MPI_COMM_WORLD);
-      bool is_sorted = left_sorted && right_sorted;
-      MPI_Allreduce(MPI_IN_PLACE, &is_sorted, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
-      if (is_sorted) {
-        break;
-      }
-    }
-  }
-
-  bool SmallSort(int rank, size_t off, size_t shift,
-                 size_t proc_size, size_t window_size,
-                 size_t data_size) {
-    VecT vec(vec_);
-    bool is_sorted = true;
-    size_t cur_size = 0;
-    vec += off;
-    while (cur_size < proc_size && off < data_size) {
-      printf("Completion of sorting windows on process %d: %.2f%%\n", rank, 100.0 * cur_size / proc_size);
-      if (is_sorted && !vec.IsSorted(0, window_size)) {
-        is_sorted = false;
-      }
-      vec.Sort(0, window_size);
-      off += shift;
-      vec += shift;
-      cur_size += shift;
-      if (off + shift > data_size) {
-        shift = data_size - off;
-      }
-      if (off + window_size > data_size) {
-        shift = window_size - off;
-        window_size = data_size - off;
-      }
-    }
-    return is_sorted;
+  MPI_Comm comm_;
+  int rank_, nprocs_;
+  size_t window_elmts_;                /**< Elements of a run */
+  size_t fan_in_;                      /**< Runs merged at once */
+  size_t oversample_ = 16;             /**< Samples per run */
+  VecT data_;                          /**< The file being sorted */
+  VecT tmp_;                           /**< Runs of alternate passes */
+  std::vector<std::pair<size_t, size_t>> runs_;  /**< Local (off, size) */
+  size_t passes_ = 0;                  /**< Passes over the file */
+  size_t out_off_ = 0;                 /**< First output element of rank */
+  size_t out_size_ = 0;                /**< Output elements of rank */
+
+ public:
+  /** Sort the file at path in place (collective) */
+  void Sort(MPI_Comm comm, const std::string &path, size_t window_size) {
+    comm_ = comm;
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &nprocs_);
+    // Runs (or merge buffers) get half the window, the streams the rest
+    data_.InitComm(comm_, path, MM_READ_WRITE);
+    data_.BoundMemory(window_size / 4);
+    data_.EvenPgas(data_.size());
+    tmp_.InitComm(comm_, path + ".runs", data_.size(), MM_READ_WRITE);
+    tmp_.BoundMemory(window_size / 4);
+    size_t page_elmts = data_.elmts_per_page_;
+    window_elmts_ = std::max<size_t>(window_size / 2 / sizeof(T), page_elmts);
+    fan_in_ = std::max<size_t>(window_elmts_ / page_elmts, 2);
+    // Plan the passes
+    size_t local_runs =
+        (data_.local_size() + window_elmts_ - 1) / window_elmts_;
+    size_t max_runs = local_runs;
+    MPI_Allreduce(MPI_IN_PLACE, &max_runs, 1, MPI_UNSIGNED_LONG,
+                  MPI_MAX, comm_);
+    size_t local_passes = 0;
+    // With more ranks than fan_in_, MergeGlobal adds passes of its own
+    while (max_runs > 1 && max_runs * nprocs_ > fan_in_) {
+      max_runs = (max_runs + fan_in_ - 1) / fan_in_;
+      local_runs = (local_runs + fan_in_ - 1) / fan_in_;
+      ++local_passes;
+    }
+    size_t total_runs = local_runs;
+    MPI_Allreduce(MPI_IN_PLACE, &total_runs, 1, MPI_UNSIGNED_LONG,
+                  MPI_SUM, comm_);
+    bool global = total_runs > 1;
+    passes_ = 1 + local_passes + global;
+    HILOG(kInfo, "{}: Sorting {} elements in {} passes",
+          rank_, data_.size(), passes_);
+    // Run formation writes the file if an even number of passes follow
+    VecT *src = &tmp_, *dst = &data_;
+    if ((local_passes + global) % 2) {
+      std::swap(src, dst);
+    }
+    FormRuns(*dst);
+    for (size_t i = 0; i < local_passes; ++i) {
+      std::swap(src, dst);
+      MergeLocal(*src, *dst);
+    }
+    if (global) {
+      MergeGlobal(tmp_, data_);
+    } else {
+      out_off_ = data_.local_off();
+      out_size_ = data_.local_size();
+    }
+    data_.Barrier(MM_READ_ONLY);
+    tmp_.Destroy();
+  }
+
+  /** Sort window-sized runs of the local partition into dst */
+  void FormRuns(VecT &dst) {
+    std::vector<T> buf;
+    size_t end = data_.local_last();
+    for (size_t off = data_.local_off(); off < end; off += window_elmts_) {
+      size_t count = std::min(window_elmts_, end - off);
+      buf.resize(count);
+      data_.SeqTxBegin(off, count, MM_READ_ONLY);
+      for (size_t i = 0; i < count; ++i) {
+        buf[i] = data_.Read(off + i);
+      }
+      data_.TxEnd();
+      mm::ParallelSort(buf.data(), buf.data() + count);
+      dst.SeqTxBegin(off, count, MM_WRITE_ONLY);
+      for (size_t i = 0; i < count; ++i) {
+        dst.Write(off + i) = buf[i];
+      }
+      dst.TxEnd();
+      runs_.emplace_back(off, count);
+    }
+  }
+
+  /** Merge groups of fan_in_ local runs from src into dst */
+  void MergeLocal(VecT &src, VecT &dst) {
+    std::vector<std::pair<size_t, size_t>> merged;
+    for (size_t i = 0; i < runs_.size(); i += fan_in_) {
+      size_t last = std::min(i + fan_in_, runs_.size());
+      std::vector<Run> runs;
+      for (size_t j = i; j < last; ++j) {
+        runs.emplace_back(Run{runs_[j].first,
+                              runs_[j].first + runs_[j].second});
+      }
+      size_t off = runs_[i].first;
+      size_t size = runs_[last - 1].first + runs_[last - 1].second - off;
+      MergeRuns(src, runs, dst, off);
+      merged.emplace_back(off, size);
+    }
+    runs_ = std::move(merged);
+  }
+
+  /** Merge the runs of every rank from src into this rank's output */
+  void MergeGlobal(VecT &src, VecT &dst) {
+    std::vector<std::pair<size_t, size_t>> all_runs = GatherRuns();
+    std::vector<T> splitters = FindSplitters(src);
+    std::vector<Run> runs;
+    out_off_ = 0;
+    for (auto &run : all_runs) {
+      size_t run_end = run.first + run.second;
+      size_t lo = rank_ == 0 ? run.first :
+          LowerBound(src, run.first, run_end, splitters[rank_ - 1]);
+      size_t hi = rank_ == nprocs_ - 1 ? run_end :
+          LowerBound(src, run.first, run_end, splitters[rank_]);
+      out_off_ += lo - run.first;
+      if (lo < hi) {
+        runs.emplace_back(Run{lo, hi});
+      }
+    }
+    out_size_ = CascadeMerge(src, runs, dst, out_off_);
+  }
+
+  /**
+   * Merge runs of src into dst at out_off in passes of at most fan_in_
+   * runs, so the merge buffers fit in the window even when there are
+   * more ranks than fan_in_. Intermediate passes alternate between a
+   * private scratch file and this rank's output range of dst.
+   *
+   * @return The number of elements merged
+   * */
+  size_t CascadeMerge(VecT &src, std::vector<Run> &runs,
+                      VecT &dst, size_t out_off) {
+    if (runs.size() <= fan_in_) {
+      return MergeRuns(src, runs, dst, out_off);
+    }
+    size_t num_passes = 0, total = 0;
+    for (size_t n = runs.size(); n > fan_in_;
+         n = (n + fan_in_ - 1) / fan_in_) {
+      ++num_passes;
+    }
+    for (Run &run : runs) {
+      total += run.end_ - run.off_;
+    }
+    VecT scratch;
+    scratch.InitComm(MPI_COMM_SELF,
+                     tmp_.path_ + ".merge_" + std::to_string(rank_),
+                     total, MM_READ_WRITE);
+    // The last intermediate pass writes the scratch file
+    VecT *cur = &src;
+    for (size_t pass = 1; pass <= num_passes; ++pass) {
+      bool to_scratch = (num_passes - pass) % 2 == 0;
+      VecT *next = to_scratch ? &scratch : &dst;
+      size_t pos = to_scratch ? 0 : out_off;
+      std::vector<Run> merged;
+      for (size_t i = 0; i < runs.size(); i += fan_in_) {
+        std::vector<Run> group(
+            runs.begin() + i,
+            runs.begin() + std::min(i + fan_in_, runs.size()));
+        size_t count = MergeRuns(*cur, group, *next, pos);
+        merged.emplace_back(Run{pos, pos + count});
+        pos += count;
+      }
+      runs = std::move(merged);
+      cur = next;
+    }
+    passes_ += num_passes;
+    size_t out_size = MergeRuns(*cur, runs, dst, out_off);
+    scratch.Destroy();
+    return out_size;
+  }
+
+  /** Gather the (off, size) of the runs of every rank */
+  std::vector<std::pair<size_t, size_t>> GatherRuns() {
+    int count = (int)(runs_.size() * sizeof(runs_[0]));
+    std::vector<int> counts(nprocs_), displs(nprocs_);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm_);
+    int total = 0;
+    for (int i = 0; i < nprocs_; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+    std::vector<std::pair<size_t, size_t>> all_runs(
+        total / sizeof(runs_[0]));
+    MPI_Allgatherv(runs_.data(), count, MPI_BYTE,
+                   all_runs.data(), counts.data(), displs.data(),
+                   MPI_BYTE, comm_);
+    return all_runs;
+  }
+
+  /** Choose nprocs - 1 splitters from evenly spaced run elements */
+  std::vector<T> FindSplitters(VecT &src) {
+    std::vector<T> samples;
+    for (auto &run : runs_) {
+      for (size_t i = 0; i < oversample_ && i < run.second; ++i) {
+        samples.emplace_back(
+            src.Read(run.first + run.second * i / oversample_));
+      }
+    }
+    int count = (int)(samples.size() * sizeof(T));
+    std::vector<int> counts(nprocs_), displs(nprocs_);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm_);
+    int total = 0;
+    for (int i = 0; i < nprocs_; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+    std::vector<T> all(total / sizeof(T));
+    MPI_Allgatherv(samples.data(), count, MPI_BYTE,
+                   all.data(), counts.data(), displs.data(),
+                   MPI_BYTE, comm_);
+    std::sort(all.begin(), all.end());
+    std::vector<T> splitters;
+    for (int i = 1; i < nprocs_; ++i) {
+      splitters.emplace_back(all.size() ? all[all.size() * i / nprocs_] : T{});
+    }
+    return splitters;
+  }
+
+  /** First index in the sorted range [off, end) not less than val */
+  size_t LowerBound(VecT &src, size_t off, size_t end, const T &val) {
+    while (off < end) {
+      size_t mid = off + (end - off) / 2;
+      if (src.Read(mid) < val) {
+        off = mid + 1;
+      } else {
+        end = mid;
+      }
+    }
+    return off;
+  }
+
+  /**
+   * K-way merge runs of src into dst, starting at out_off
+   *
+   * @return The number of elements merged
+   * */
+  size_t MergeRuns(VecT &src, std::vector<Run> &runs,
+                   VecT &dst, size_t out_off) {
+    size_t out_size = 0;
+    for (Run &run : runs) {
+      out_size += run.end_ - run.off_;
+    }
+    if (out_size == 0) {
+      return 0;
+    }
+    // Split the merge buffer among the runs
+    size_t buf_elmts = std::max<size_t>(
+        window_elmts_ / std::max<size_t>(runs.size(), 1),
+        src.elmts_per_page_);
+    using Head = std::pair<T, size_t>;
+    auto greater = [](const Head &a, const Head &b) {
+      return b.first < a.first;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(greater)>
+        heap(greater);
+    for (size_t i = 0; i < runs.size(); ++i) {
+      Refill(src, runs[i], buf_elmts);
+      heap.emplace(runs[i].buf_[0], i);
+    }
+    dst.SeqTxBegin(out_off, out_size, MM_WRITE_ONLY);
+    size_t idx = out_off;
+    while (!heap.empty()) {
+      Head head = heap.top();
+      heap.pop();
+      dst.Write(idx++) = head.first;
+      Run &run = runs[head.second];
+      if (++run.pos_ == run.buf_.size()) {
+        if (run.off_ == run.end_) {
+          continue;
+        }
+        Refill(src, run, buf_elmts);
+      }
+      heap.emplace(run.buf_[run.pos_], head.second);
+    }
+    dst.TxEnd();
+    return out_size;
+  }
+
+  /** Read the next part of a run with a sequential transaction */
+  void Refill(VecT &src, Run &run, size_t buf_elmts) {
+    size_t count = std::min(buf_elmts, run.end_ - run.off_);
+    run.buf_.resize(count);
+    src.SeqTxBegin(run.off_, count, MM_READ_ONLY);
+    for (size_t i = 0; i < count; ++i) {
+      run.buf_[i] = src.Read(run.off_ + i);
+    }
+    src.TxEnd();
+    run.off_ += count;
+    run.pos_ = 0;
+  }
+
+  /** Check that the file is globally sorted (collective) */
+  bool Verify() {
+    return VerifySorted<VecT, T>(data_, out_off_, out_size_, comm_);
+  }
+};
+
+/**
+ * Out-of-core distributed sample sort over VectorMegaMpi.
+ *
+ * 1. Splitters are chosen from pages sampled evenly across each
+ * rank's partition of the input.
+ * 2. The input is read in window-sized rounds. Each round is sorted,
+ * cut at the splitters, and redistributed with MPI_Alltoallv. The
+ * pieces each rank receives are merged into a sorted run, which is
+ * appended to a private runs vector.
+ * 3. An MPI_Exscan of the run totals places each rank's output, and
+ * the runs are k-way merged into the output with sequential
+ * transactions.
+ * */
+template<typename T>
+class MegaSortMpi {
+ public:
+  /** A sorted run being merged */
+  struct Run {
+    size_t off_;           /**< Next element to read from runs_ */
+    size_t end_;           /**< One past the last element of the run */
+    std::vector<T> buf_;   /**< Elements read from runs_ */
+    size_t pos_ = 0;       /**< Next element of buf_ */
+  };
+
+ public:
+  MPI_Comm comm_;
+  int rank_, nprocs_;
+  size_t window_size_;
+  size_t oversample_ = 16;             /**< Sample pages per rank */
+  mm::VectorMegaMpi<T> in_;            /**< The unsorted input */
+  mm::VectorMegaMpi<T> runs_;          /**< Private sorted runs */
+  mm::VectorMegaMpi<T> out_;           /**< The sorted output */
+  std::vector<T> splitters_;           /**< Upper bounds of ranks 0..n-2 */
+  std::vector<std::pair<size_t, size_t>> run_bounds_;  /**< (off, size) */
+  size_t out_off_ = 0;                 /**< First output element of rank */
+  size_t out_size_ = 0;                /**< Output elements of rank */
+
+ public:
+  /** Sort the file at path into out_path (collective) */
+  void Sort(MPI_Comm comm, const std::string &path,
+            const std::string &out_path, size_t window_size) {
+    comm_ = comm;
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &nprocs_);
+    window_size_ = window_size;
+    // Each vector gets a share of the window
+    in_.Init(path, MM_READ_ONLY | MM_STAGE);
+    in_.BoundMemory(window_size_ / 4);
+    in_.EvenPgas(rank_, nprocs_, in_.size());
+    in_.Allocate();
+    runs_.Init(out_path + ".runs." + std::to_string(rank_),
+               0, MM_APPEND_ONLY);
+    runs_.BoundMemory(window_size_ / 4);
+    runs_.Allocate();
+    FindSplitters();
+    Exchange();
+    Merge(out_path);
+    runs_.Destroy();
+  }
+
+  /** Choose nprocs - 1 splitters from evenly spaced sample pages */
+  void FindSplitters() {
+    std::vector<T> samples;
+    size_t local_size = in_.local_size();
+    size_t page_elmts = std::min(in_.elmts_per_page_, local_size);
+    size_t num_samples = local_size ? oversample_ : 0;
+    size_t stride = page_elmts / oversample_ + 1;
+    for (size_t i = 0; i < num_samples; ++i) {
+      size_t off = in_.local_off() +
+          (local_size - page_elmts) * i / num_samples;
+      in_.SeqTxBegin(off, page_elmts, MM_READ_ONLY);
+      for (size_t j = 0; j < page_elmts; j += stride) {
+        samples.emplace_back(in_[off + j]);
+      }
+      in_.TxEnd();
+    }
+    int count = (int)(samples.size() * sizeof(T));
+    std::vector<int> counts(nprocs_), displs(nprocs_);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm_);
+    int total = 0;
+    for (int i = 0; i < nprocs_; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+    std::vector<T> all(total / sizeof(T));
+    MPI_Allgatherv(samples.data(), count, MPI_BYTE,
+                   all.data(), counts.data(), displs.data(),
+                   MPI_BYTE, comm_);
+    std::sort(all.begin(), all.end());
+    splitters_.clear();
+    for (int i = 1; i < nprocs_ && all.size(); ++i) {
+      splitters_.emplace_back(all[all.size() * i / nprocs_]);
+    }
+  }
+
+  /** Redistribute the input into sorted runs on their destination rank */
+  void Exchange() {
+    size_t round_elmts = std::max<size_t>(
+        window_size_ / 4 / sizeof(T), in_.elmts_per_page_);
+    size_t num_rounds = (in_.local_size() + round_elmts - 1) / round_elmts;
+    MPI_Allreduce(MPI_IN_PLACE, &num_rounds, 1, MPI_UNSIGNED_LONG,
+                  MPI_MAX, comm_);
+    std::vector<T> send, recv;
+    std::vector<int> send_counts(nprocs_), send_displs(nprocs_);
+    std::vector<int> recv_counts(nprocs_), recv_displs(nprocs_);
+    size_t run_off = 0;
+    for (size_t round = 0; round < num_rounds; ++round) {
+      // Read and sort the next round of the local partition
+      size_t off = std::min(round * round_elmts, in_.local_size());
+      size_t count = std::min(round_elmts, in_.local_size() - off);
+      off += in_.local_off();
+      send.resize(count);
+      if (count) {
+        in_.SeqTxBegin(off, count, MM_READ_ONLY);
+        for (size_t i = 0; i < count; ++i) {
+          send[i] = in_[off + i];
+        }
+        in_.TxEnd();
+      }
+      std::sort(send.begin(), send.end());
+      // Cut the sorted round at the splitters
+      size_t prior = 0;
+      for (int i = 0; i < nprocs_; ++i) {
+        size_t end = i < (int)splitters_.size() ?
+            std::upper_bound(send.begin(), send.end(), splitters_[i]) -
+            send.begin() : send.size();
+        end = std::max(end, prior);
+        send_displs[i] = (int)(prior * sizeof(T));
+        send_counts[i] = (int)((end - prior) * sizeof(T));
+        prior = end;
+      }
+      MPI_Alltoall(send_counts.data(), 1, MPI_INT,
+                   recv_counts.data(), 1, MPI_INT, comm_);
+      int total = 0;
+      for (int i = 0; i < nprocs_; ++i) {
+        recv_displs[i] = total;
+        total += recv_counts[i];
+      }
+      recv.resize(total / sizeof(T));
+      MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(),
+                    MPI_BYTE, recv.data(), recv_counts.data(),
+                    recv_displs.data(), MPI_BYTE, comm_);
+      // Each sender's piece is sorted, so merge them into one run
+      for (int i = 1; i < nprocs_; ++i) {
+        std::inplace_merge(recv.begin(),
+                           recv.begin() + recv_displs[i] / sizeof(T),
+                           recv.begin() + (recv_displs[i] +
+                               recv_counts[i]) / sizeof(T));
+      }
+      if (recv.empty()) {
+        continue;
+      }
+      for (const T &elmt : recv) {
+        runs_.emplace_back(elmt);
+      }
+      run_bounds_.emplace_back(run_off, recv.size());
+      run_off += recv.size();
+    }
+    runs_.FlushEmplace(MPI_COMM_SELF);
+    out_size_ = run_off;
+    MPI_Exscan(&out_size_, &out_off_, 1, MPI_UNSIGNED_LONG,
+               MPI_SUM, comm_);
+    if (rank_ == 0) {
+      out_off_ = 0;
+    }
+    HILOG(kInfo, "{}: Received {} runs of {} elements at offset {}",
+          rank_, run_bounds_.size(), out_size_, out_off_);
+  }
+
+  /**
+   * K-way merge the local runs into the output. Ranks write at their
+   * Exscan offsets, so a page at the edge of a rank's output may have
+   * several writers in the same epoch. This relies on the per-element
+   * dirty bits of VectorMegaMpi: a flush only puts the runs a rank
+   * wrote, so writers never overwrite each other's elements.
+   * */
+  void Merge(const std::string &out_path) {
+    out_.Init(out_path, in_.size(), MM_WRITE_ONLY);
+    out_.BoundMemory(window_size_ / 4);
+    out_.Allocate();
+    // Split the merge buffer among the runs
+    std::vector<Run> runs(run_bounds_.size());
+    size_t buf_elmts = std::max<size_t>(
+        window_size_ / 4 / sizeof(T) / std::max<size_t>(runs.size(), 1),
+        runs_.elmts_per_page_);
+    using Head = std::pair<T, size_t>;
+    auto greater = [](const Head &a, const Head &b) {
+      return b.first < a.first;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(greater)>
+        heap(greater);
+    for (size_t i = 0; i < runs.size(); ++i) {
+      runs[i].off_ = run_bounds_[i].first;
+      runs[i].end_ = run_bounds_[i].first + run_bounds_[i].second;
+      Refill(runs[i], buf_elmts);
+      heap.emplace(runs[i].buf_[0], i);
+    }
+    if (out_size_) {
+      out_.SeqTxBegin(out_off_, out_size_, MM_WRITE_ONLY);
+    }
+    size_t idx = out_off_;
+    while (!heap.empty()) {
+      Head head = heap.top();
+      heap.pop();
+      out_[idx++] = head.first;
+      Run &run = runs[head.second];
+      if (++run.pos_ == run.buf_.size()) {
+        if (run.off_ == run.end_) {
+          continue;
+        }
+        Refill(run, buf_elmts);
+      }
+      heap.emplace(run.buf_[run.pos_], head.second);
+    }
+    if (out_size_) {
+      out_.TxEnd();
+    }
+    out_.Barrier(MM_READ_ONLY, comm_);
+  }
+
+  /** Read the next part of a run with a sequential transaction */
+  void Refill(Run &run, size_t buf_elmts) {
+    size_t count = std::min(buf_elmts, run.end_ - run.off_);
+    run.buf_.resize(count);
+    runs_.SeqTxBegin(run.off_, count, MM_READ_ONLY);
+    for (size_t i = 0; i < count; ++i) {
+      run.buf_[i] = runs_[run.off_ + i];
+    }
+    runs_.TxEnd();
+    run.off_ += count;
+    run.pos_ = 0;
+  }
+
+  /** Check that the output is globally sorted (collective) */
+  bool Verify() {
+    return VerifySorted<mm::VectorMegaMpi<T>, T>(
+        out_, out_off_, out_size_, comm_);
   }
 };
 
@@ -85,12 +647,31 @@ int main(int argc, char **argv) {
   size_t window_size = hshm::ConfigParse::ParseSize(argv[3]);
   HILOG(kInfo, "Running {} on {} with window size {}", algo, path, window_size);
 
+  size_t data_size = stdfs::file_size(path);
+  MPI_Barrier(MPI_COMM_WORLD);
+  double start = MPI_Wtime(), secs = 0;
   if (algo == "mmap") {
-    BigSortMpi<mm::VectorMmapMpi<int>, int> sort;
-    sort.Sort(path, rank, nprocs, window_size);
+    MmapSortMpi<int> sort;
+    sort.Sort(MPI_COMM_WORLD, path, window_size);
+    MPI_Barrier(MPI_COMM_WORLD);
+    secs = MPI_Wtime() - start;
+    if (!sort.Verify()) {
+      HELOG(kFatal, "{} is not sorted", path);
+    }
   } else if (algo == "mega") {
+    MegaSortMpi<int> sort;
+    sort.Sort(MPI_COMM_WORLD, path, path + ".sorted", window_size);
+    MPI_Barrier(MPI_COMM_WORLD);
+    secs = MPI_Wtime() - start;
+    if (!sort.Verify()) {
+      HELOG(kFatal, "The output of {} is not sorted", path);
+    }
   } else {
     HILOG(kFatal, "Unknown algorithm: {}", algo);
   }
+  if (rank == 0) {
+    HILOG(kInfo, "Sorted {} bytes in {} seconds ({} GB/s)",
+          data_size, secs, data_size / secs / (1 << 30));
+  }
   MPI_Finalize();
 }
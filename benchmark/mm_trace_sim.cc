@@ -0,0 +1,464 @@
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include "hermes_shm/util/logging.h"
+#include "hermes_shm/util/config_parse.h"
+
+#include "mega_mmap/page_trace.h"
+
+namespace stdfs = std::filesystem;
+
+/** Which page the simulated window evicts when it is full */
+enum class EvictPolicy {
+  kLru,    /**< Least recently accessed */
+  kFifo,   /**< Least recently faulted */
+  kHint,   /**< Pages released by Rescore, then least recently accessed */
+  kOpt     /**< Accessed furthest in the future (Belady) */
+};
+
+/** Which pages the simulated window reads ahead of use */
+enum class Prefetcher {
+  kNone,
+  kNext,    /**< The page after a faulted page */
+  kStride,  /**< Continue a repeated stride between faults */
+  kHint     /**< The pages Rescore asked for */
+};
+
+/** One configuration of the simulated page cache */
+struct SimConfig {
+  size_t window_size_;
+  size_t page_size_;
+  std::string policy_;
+  std::string prefetch_;
+};
+
+/** What a replay observed */
+struct SimResult {
+  u64 accesses_ = 0;           /**< Page transitions replayed */
+  u64 hits_ = 0;               /**< Transitions to resident pages */
+  u64 prefetch_hits_ = 0;      /**< First accesses to prefetched pages */
+  u64 faults_ = 0;             /**< Transitions to missing pages */
+  u64 prefetches_ = 0;         /**< Pages read ahead of use */
+  u64 wasted_prefetches_ = 0;  /**< Prefetched pages never accessed */
+  u64 evictions_ = 0;          /**< Pages dropped from the window */
+  u64 bytes_in_ = 0;           /**< Bytes read from the backend */
+  u64 bytes_out_ = 0;          /**< Dirty bytes written to the backend */
+
+  SimResult& operator+=(const SimResult &other) {
+    accesses_ += other.accesses_;
+    hits_ += other.hits_;
+    prefetch_hits_ += other.prefetch_hits_;
+    faults_ += other.faults_;
+    prefetches_ += other.prefetches_;
+    wasted_prefetches_ += other.wasted_prefetches_;
+    evictions_ += other.evictions_;
+    bytes_in_ += other.bytes_in_;
+    bytes_out_ += other.bytes_out_;
+    return *this;
+  }
+};
+
+/** A page in the simulated window */
+struct SimPage {
+  bool dirty_ = false;
+  bool prefetched_ = false;   /**< Read ahead and not accessed yet */
+  size_t released_ = 0;       /**< Bytes released by Rescore */
+  u64 next_use_ = 0;          /**< Position of the next access (kOpt) */
+  std::list<u64>::iterator pos_;  /**< Position in order_ */
+};
+
+/**
+ * Replays the events of one vector of one rank against a window of
+ * whole pages. Elements are re-paged with the simulated page size;
+ * page sizes which are multiples of the traced one are exact, since
+ * only page transitions are traced.
+ * */
+class CacheSim {
+ public:
+  SimConfig conf_;
+  EvictPolicy policy_;
+  Prefetcher prefetch_;
+  size_t elmt_size_;
+  size_t max_pages_;
+  u64 last_page_ = 0;        /**< Largest page of the trace */
+  std::unordered_map<u64, SimPage> pages_;
+  std::list<u64> order_;     /**< Eviction order (front first) */
+  std::set<std::pair<u64, u64>> opt_;  /**< (next use, page) for kOpt */
+  std::unordered_map<u64, std::vector<u64>> uses_;  /**< Accesses per page */
+  u64 pos_ = 0;              /**< Number of accesses replayed */
+  u64 last_fault_ = 0;
+  int64_t stride_ = 0;
+  SimResult res_;
+
+ public:
+  CacheSim(const SimConfig &conf, EvictPolicy policy, Prefetcher prefetch,
+           size_t elmt_size)
+      : conf_(conf), policy_(policy), prefetch_(prefetch),
+        elmt_size_(elmt_size) {
+    max_pages_ = std::max<size_t>(conf.window_size_ / conf.page_size_, 1);
+  }
+
+  /** The simulated page of an element */
+  u64 PageOf(u64 idx) const {
+    return idx * elmt_size_ / conf_.page_size_;
+  }
+
+  /** Replay the events of the vector */
+  SimResult Run(const std::vector<mm::PageTraceRecord> &events) {
+    u64 pos = 0;
+    for (const mm::PageTraceRecord &rec : events) {
+      if (_IsAccess(rec)) {
+        u64 page = PageOf(rec.idx_);
+        last_page_ = std::max(last_page_, page);
+        if (policy_ == EvictPolicy::kOpt) {
+          uses_[page].emplace_back(pos);
+        }
+        ++pos;
+      }
+    }
+    for (const mm::PageTraceRecord &rec : events) {
+      switch ((mm::PageTraceOp)rec.op_) {
+        case mm::PageTraceOp::kRead:
+        case mm::PageTraceOp::kWrite: {
+          Access(PageOf(rec.idx_),
+                 rec.op_ == (u32)mm::PageTraceOp::kWrite);
+          break;
+        }
+        case mm::PageTraceOp::kEvict: {
+          if (policy_ == EvictPolicy::kHint) {
+            Release(rec.idx_, rec.count_);
+          }
+          break;
+        }
+        case mm::PageTraceOp::kPrefetch: {
+          if (prefetch_ == Prefetcher::kHint) {
+            u64 first = PageOf(rec.idx_);
+            u64 last = PageOf(rec.idx_ + std::max<u64>(rec.count_, 1) - 1);
+            for (u64 page = first; page <= last; ++page) {
+              Prefetch(page);
+            }
+          }
+          break;
+        }
+        default: {
+          break;
+        }
+      }
+    }
+    // Dirty pages are flushed at the end
+    for (auto &[page, sim_page] : pages_) {
+      if (sim_page.dirty_) {
+        res_.bytes_out_ += conf_.page_size_;
+      }
+      if (sim_page.prefetched_) {
+        ++res_.wasted_prefetches_;
+      }
+    }
+    return res_;
+  }
+
+  /** Whether a record is an access */
+  static bool _IsAccess(const mm::PageTraceRecord &rec) {
+    return rec.op_ == (u32)mm::PageTraceOp::kRead ||
+        rec.op_ == (u32)mm::PageTraceOp::kWrite;
+  }
+
+  /** Replay an access */
+  void Access(u64 page, bool write) {
+    ++res_.accesses_;
+    auto it = pages_.find(page);
+    bool fault = it == pages_.end();
+    if (!fault) {
+      ++res_.hits_;
+      SimPage &sim_page = it->second;
+      if (sim_page.prefetched_) {
+        ++res_.prefetch_hits_;
+        sim_page.prefetched_ = false;
+      }
+      if (policy_ == EvictPolicy::kLru || policy_ == EvictPolicy::kHint) {
+        order_.splice(order_.end(), order_, sim_page.pos_);
+      }
+    } else {
+      ++res_.faults_;
+      res_.bytes_in_ += conf_.page_size_;
+      Insert(page, false);
+    }
+    SimPage &sim_page = pages_[page];
+    sim_page.dirty_ |= write;
+    _SetNextUse(page, sim_page, pos_ + 1);
+    ++pos_;
+    if (fault) {
+      _PrefetchAfterFault(page);
+    }
+  }
+
+  /** Read a page ahead of use */
+  void Prefetch(u64 page) {
+    if (page > last_page_ || pages_.find(page) != pages_.end()) {
+      return;
+    }
+    // Belady never displaces a page which is needed sooner
+    if (policy_ == EvictPolicy::kOpt && pages_.size() >= max_pages_ &&
+        _NextUse(page, pos_) >= opt_.rbegin()->first) {
+      return;
+    }
+    ++res_.prefetches_;
+    res_.bytes_in_ += conf_.page_size_;
+    Insert(page, true);
+    _SetNextUse(page, pages_[page], pos_);
+  }
+
+  /** Release the elements [idx, idx + count), evicting whole pages */
+  void Release(u64 idx, u64 count) {
+    u64 off = idx * elmt_size_;
+    u64 end = (idx + count) * elmt_size_;
+    while (off < end) {
+      u64 page = off / conf_.page_size_;
+      u64 page_end = std::min<u64>((page + 1) * conf_.page_size_, end);
+      auto it = pages_.find(page);
+      if (it != pages_.end()) {
+        it->second.released_ += page_end - off;
+        if (it->second.released_ >= conf_.page_size_) {
+          Evict(page);
+        }
+      }
+      off = page_end;
+    }
+  }
+
+  /** Add a page, evicting pages while the window is full */
+  void Insert(u64 page, bool prefetched) {
+    while (pages_.size() >= max_pages_) {
+      Evict(_Victim());
+    }
+    SimPage &sim_page = pages_[page];
+    sim_page.prefetched_ = prefetched;
+    sim_page.pos_ = order_.insert(order_.end(), page);
+  }
+
+  /** Drop a page, writing it back if dirty */
+  void Evict(u64 page) {
+    auto it = pages_.find(page);
+    SimPage &sim_page = it->second;
+    if (sim_page.dirty_) {
+      res_.bytes_out_ += conf_.page_size_;
+    }
+    if (sim_page.prefetched_) {
+      ++res_.wasted_prefetches_;
+    }
+    ++res_.evictions_;
+    order_.erase(sim_page.pos_);
+    opt_.erase({sim_page.next_use_, page});
+    pages_.erase(it);
+  }
+
+  /** The page to evict next */
+  u64 _Victim() {
+    if (policy_ == EvictPolicy::kOpt) {
+      return opt_.rbegin()->second;
+    }
+    return order_.front();
+  }
+
+  /** Issue the prefetches which follow a fault */
+  void _PrefetchAfterFault(u64 page) {
+    switch (prefetch_) {
+      case Prefetcher::kNext: {
+        Prefetch(page + 1);
+        break;
+      }
+      case Prefetcher::kStride: {
+        int64_t stride = (int64_t)page - (int64_t)last_fault_;
+        if (stride != 0 && stride == stride_ && (int64_t)page + stride >= 0) {
+          Prefetch(page + stride);
+        }
+        stride_ = stride;
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+    last_fault_ = page;
+  }
+
+  /** The position of the first access to a page at or after pos */
+  u64 _NextUse(u64 page, u64 pos) {
+    std::vector<u64> &uses = uses_[page];
+    auto it = std::lower_bound(uses.begin(), uses.end(), pos);
+    return it == uses.end() ? UINT64_MAX : *it;
+  }
+
+  /** Update the next use of a resident page (kOpt) */
+  void _SetNextUse(u64 page, SimPage &sim_page, u64 pos) {
+    if (policy_ != EvictPolicy::kOpt) {
+      return;
+    }
+    opt_.erase({sim_page.next_use_, page});
+    sim_page.next_use_ = _NextUse(page, pos);
+    opt_.emplace(sim_page.next_use_, page);
+  }
+};
+
+/** Split a comma-separated list */
+std::vector<std::string> SplitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    items.emplace_back(item);
+  }
+  return items;
+}
+
+/** Parse the name of an eviction policy */
+EvictPolicy ParsePolicy(const std::string &name) {
+  if (name == "lru") {
+    return EvictPolicy::kLru;
+  } else if (name == "fifo") {
+    return EvictPolicy::kFifo;
+  } else if (name == "hint") {
+    return EvictPolicy::kHint;
+  } else if (name == "opt") {
+    return EvictPolicy::kOpt;
+  }
+  HELOG(kFatal, "Unknown eviction policy {} (lru, fifo, hint, opt)", name);
+  return EvictPolicy::kLru;
+}
+
+/** Parse the name of a prefetcher */
+Prefetcher ParsePrefetcher(const std::string &name) {
+  if (name == "none") {
+    return Prefetcher::kNone;
+  } else if (name == "next") {
+    return Prefetcher::kNext;
+  } else if (name == "stride") {
+    return Prefetcher::kStride;
+  } else if (name == "hint") {
+    return Prefetcher::kHint;
+  }
+  HELOG(kFatal, "Unknown prefetcher {} (none, next, stride, hint)", name);
+  return Prefetcher::kNone;
+}
+
+/** The events of each vector of a rank's trace */
+struct RankTrace {
+  std::vector<mm::PageTraceVector> vecs_;
+  std::vector<std::vector<mm::PageTraceRecord>> events_;
+};
+
+/** Read {prefix}.{rank}.mmt for every rank */
+std::vector<RankTrace> ReadTraces(const std::string &prefix) {
+  std::vector<RankTrace> traces;
+  for (int rank = 0; ; ++rank) {
+    std::string path = hshm::Formatter::format("{}.{}.mmt", prefix, rank);
+    if (!stdfs::exists(path)) {
+      break;
+    }
+    mm::PageTraceReader reader;
+    if (!reader.Read(path)) {
+      continue;
+    }
+    RankTrace trace;
+    trace.vecs_ = reader.vecs_;
+    trace.events_.resize(reader.vecs_.size());
+    for (mm::PageTraceRecord &rec : reader.recs_) {
+      if (rec.vec_ < trace.events_.size()) {
+        trace.events_[rec.vec_].emplace_back(rec);
+      }
+    }
+    traces.emplace_back(std::move(trace));
+  }
+  return traces;
+}
+
+/** Write a result row in the column format of the analysis/ CSVs */
+void WriteRow(std::ofstream &out, const std::string &vec,
+              const SimConfig &conf, const SimResult &res) {
+  double hit_rate = res.accesses_ ? (double)res.hits_ / res.accesses_ : 0;
+  out << vec << "," << conf.window_size_ << "," << conf.page_size_ << ","
+      << conf.policy_ << "," << conf.prefetch_ << ","
+      << res.accesses_ << "," << res.hits_ << "," << hit_rate << ","
+      << res.prefetch_hits_ << "," << res.faults_ << ","
+      << res.prefetches_ << "," << res.wasted_prefetches_ << ","
+      << res.evictions_ << "," << res.bytes_in_ << ","
+      << res.bytes_out_ << "\n";
+}
+
+/**
+ * Replay page traces (MM_PAGE_TRACE) against every combination of
+ * window size, page size, eviction policy, and prefetcher. Each rank
+ * and vector gets its own window, as with BoundMemory. Hit rates are
+ * over page transitions, since accesses within a page are not traced.
+ * */
+int main(int argc, char **argv) {
+  if (argc != 7) {
+    HILOG(kFatal, "USAGE: ./mm_trace_sim [trace_prefix] [window_sizes] "
+          "[page_sizes] [policies] [prefetchers] [csv_path]");
+  }
+  std::string prefix = argv[1];
+  std::vector<size_t> window_sizes, page_sizes;
+  for (std::string &size : SplitList(argv[2])) {
+    window_sizes.emplace_back(hshm::ConfigParse::ParseSize(size));
+  }
+  for (std::string &size : SplitList(argv[3])) {
+    page_sizes.emplace_back(hshm::ConfigParse::ParseSize(size));
+  }
+  std::vector<std::string> policies = SplitList(argv[4]);
+  std::vector<std::string> prefetchers = SplitList(argv[5]);
+  std::string csv_path = argv[6];
+
+  std::vector<RankTrace> traces = ReadTraces(prefix);
+  if (traces.empty()) {
+    HELOG(kFatal, "No page traces named {}.<rank>.mmt", prefix);
+  }
+  HILOG(kInfo, "Replaying the page traces of {} ranks", traces.size());
+
+  std::ofstream out(csv_path);
+  out << "mm_trace_sim.vector,mm_trace_sim.window_size,"
+         "mm_trace_sim.page_size,mm_trace_sim.policy,"
+         "mm_trace_sim.prefetch,mm_trace_sim.accesses,mm_trace_sim.hits,"
+         "mm_trace_sim.hit_rate,mm_trace_sim.prefetch_hits,"
+         "mm_trace_sim.faults,mm_trace_sim.prefetches,"
+         "mm_trace_sim.wasted_prefetches,mm_trace_sim.evictions,"
+         "mm_trace_sim.bytes_in,mm_trace_sim.bytes_out\n";
+  for (size_t window_size : window_sizes) {
+    for (size_t page_size : page_sizes) {
+      for (const std::string &policy : policies) {
+        for (const std::string &prefetch : prefetchers) {
+          SimConfig conf{window_size, page_size, policy, prefetch};
+          std::map<std::string, SimResult> results;
+          SimResult total;
+          for (RankTrace &trace : traces) {
+            for (size_t v = 0; v < trace.vecs_.size(); ++v) {
+              CacheSim sim(conf, ParsePolicy(policy),
+                           ParsePrefetcher(prefetch),
+                           trace.vecs_[v].elmt_size_);
+              SimResult res = sim.Run(trace.events_[v]);
+              results[trace.vecs_[v].name_] += res;
+              total += res;
+            }
+          }
+          for (auto &[name, res] : results) {
+            WriteRow(out, name, conf, res);
+          }
+          WriteRow(out, "all", conf, total);
+          HILOG(kInfo, "window={} page={} policy={} prefetch={}: "
+                "hit rate {}, {} bytes in, {} bytes out",
+                window_size, page_size, policy, prefetch,
+                total.accesses_ ? (double)total.hits_ / total.accesses_ : 0,
+                total.bytes_in_, total.bytes_out_);
+        }
+      }
+    }
+  }
+  HILOG(kInfo, "Wrote the results to {}", csv_path);
+}
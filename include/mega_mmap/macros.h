@@ -5,6 +5,8 @@
 #ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_MACROS_H_
 #define MEGAMMAP_INCLUDE_MEGA_MMAP_MACROS_H_
 
+#include <algorithm>
+#include <vector>
 #include <hermes_shm/data_structures/data_structure.h>
 #include <hrun/hrun_types.h>
 
@@ -13,30 +15,62 @@
 #define MM_APPEND_ONLY BIT_OPT(u32, 2)
 #define MM_READ_WRITE BIT_OPT(u32, 3)
 #define MM_STAGE BIT_OPT(u32, 4)
+#define MM_AUTO_PAGE BIT_OPT(u32, 5)
+#define MM_SEQ_ACCESS BIT_OPT(u32, 6)
+#define MM_RAND_ACCESS BIT_OPT(u32, 7)
+#define MM_PGAS_ACCESS BIT_OPT(u32, 8)
+#define MM_NODE_SHARED BIT_OPT(u32, 9)
+#define MM_SCAN_APPEND BIT_OPT(u32, 10)
+#define MM_ACCUMULATE BIT_OPT(u32, 11)
+#define MM_PACKED BIT_OPT(u32, 12)
 
 namespace mm {
 
 using hshm::bitfield32_t;
 
+/** How the elements of a vector are partitioned among ranks */
+enum class PgasLayout {
+  kEven,         /**< Equal element counts, ignoring page boundaries */
+  kPageAligned,  /**< Equal page counts, so no page has two owners */
+  kWeighted,     /**< Page-aligned, proportional to per-rank weights */
+  kBlockCyclic   /**< Pages dealt round-robin to ranks */
+};
+
 class Bounds {
  public:
-  size_t off_, size_;
-  int rank_, nprocs_;
+  size_t off_, size_;       /**< Local region (span of blocks if cyclic) */
+  size_t max_size_ = 0;     /**< Number of elements partitioned */
+  int rank_ = 0, nprocs_ = 1;
+  PgasLayout layout_ = PgasLayout::kEven;
+  size_t block_ = 1;        /**< Elements per block (the split unit) */
+  std::vector<size_t> splits_;  /**< Region offsets of each rank (+ end) */
+  std::vector<double> weights_; /**< Per-rank weights (kWeighted) */
+
  public:
   Bounds() = default;
 
   Bounds(const Bounds &other) {
     off_ = other.off_;
     size_ = other.size_;
+    max_size_ = other.max_size_;
     rank_ = other.rank_;
     nprocs_ = other.nprocs_;
+    layout_ = other.layout_;
+    block_ = other.block_;
+    splits_ = other.splits_;
+    weights_ = other.weights_;
   }
 
   Bounds &operator=(const Bounds &other) {
     off_ = other.off_;
     size_ = other.size_;
+    max_size_ = other.max_size_;
     rank_ = other.rank_;
     nprocs_ = other.nprocs_;
+    layout_ = other.layout_;
+    block_ = other.block_;
+    splits_ = other.splits_;
+    weights_ = other.weights_;
     return *this;
   }
 
@@ -47,13 +81,168 @@ class Bounds {
 
   void EvenSplit(int rank, int nprocs,
                  size_t max_size) {
-    size_ = max_size / nprocs;
-    if (rank == nprocs - 1) {
-      size_ += max_size % nprocs;
+    size_t size_pp = max_size / nprocs;
+    splits_.resize(nprocs + 1);
+    for (int i = 0; i < nprocs; ++i) {
+      splits_[i] = i * size_pp;
+    }
+    splits_[nprocs] = max_size;
+    _Finish(rank, nprocs, max_size, PgasLayout::kEven, 1);
+  }
+
+  /** Split whole blocks (e.g., pages) evenly among ranks */
+  void AlignedSplit(int rank, int nprocs,
+                    size_t max_size, size_t block) {
+    std::vector<double> weights(nprocs, 1);
+    WeightedSplit(rank, nprocs, max_size, block, weights);
+    layout_ = PgasLayout::kPageAligned;
+  }
+
+  /**
+   * Split whole blocks among ranks in proportion to their weights
+   * (e.g., memory capacity or measured throughput). Falls back to an
+   * even split if a weight is negative (or NaN) or none is positive.
+   * */
+  void WeightedSplit(int rank, int nprocs, size_t max_size,
+                     size_t block, const std::vector<double> &weights) {
+    block = std::max<size_t>(block, 1);
+    double total = 0;
+    for (int i = 0; i < nprocs && i < (int)weights.size(); ++i) {
+      if (!(weights[i] >= 0)) {
+        total = 0;
+        break;
+      }
+      total += weights[i];
+    }
+    if ((int)weights.size() < nprocs || !(total > 0)) {
+      EvenSplit(rank, nprocs, max_size);
+      return;
+    }
+    weights_ = weights;
+    size_t num_blocks = (max_size + block - 1) / block;
+    splits_.resize(nprocs + 1);
+    double cum = 0;
+    for (int i = 0; i < nprocs; ++i) {
+      size_t first_block = (size_t)(num_blocks * cum / total + .5);
+      splits_[i] = std::min(first_block * block, max_size);
+      cum += weights[i];
     }
-    off_ = rank * (max_size / nprocs);
+    splits_[nprocs] = max_size;
+    _Finish(rank, nprocs, max_size, PgasLayout::kWeighted, block);
+  }
+
+  /** Deal blocks (e.g., pages) round-robin among ranks */
+  void BlockCyclic(int rank, int nprocs,
+                   size_t max_size, size_t block) {
+    splits_.clear();
+    _Finish(rank, nprocs, max_size, PgasLayout::kBlockCyclic,
+            std::max<size_t>(block, 1));
+  }
+
+  /** Redo the split with a new block size (e.g., after a page resize) */
+  void Resplit(size_t block) {
+    switch (layout_) {
+      case PgasLayout::kEven: {
+        break;
+      }
+      case PgasLayout::kPageAligned: {
+        AlignedSplit(rank_, nprocs_, max_size_, block);
+        break;
+      }
+      case PgasLayout::kWeighted: {
+        WeightedSplit(rank_, nprocs_, max_size_, block, weights_);
+        break;
+      }
+      case PgasLayout::kBlockCyclic: {
+        BlockCyclic(rank_, nprocs_, max_size_, block);
+        break;
+      }
+    }
+  }
+
+  /** Set the local region once the layout is known */
+  void _Finish(int rank, int nprocs, size_t max_size,
+               PgasLayout layout, size_t block) {
     rank_ = rank;
     nprocs_ = nprocs;
+    max_size_ = max_size;
+    layout_ = layout;
+    block_ = block;
+    std::vector<std::pair<size_t, size_t>> ranges = RangesOf(rank);
+    if (ranges.empty()) {
+      off_ = std::min(RegionOf(rank).first, max_size);
+      size_ = 0;
+    } else {
+      off_ = ranges.front().first;
+      size_ = ranges.back().first + ranges.back().second - off_;
+    }
+  }
+
+  /**
+   * The rank whose region contains an element. A vector which was never
+   * split (no EvenPgas) is entirely local.
+   * */
+  int OwnerOf(size_t idx) const {
+    if (layout_ == PgasLayout::kBlockCyclic) {
+      return (int)((idx / block_) % nprocs_);
+    }
+    if (splits_.empty()) {
+      return rank_;
+    }
+    auto it = std::upper_bound(splits_.begin(), splits_.end() - 1, idx);
+    return std::max<int>((int)(it - splits_.begin()) - 1, 0);
+  }
+
+  /** One past the last element of the run of idx's owner containing idx */
+  size_t RunEnd(size_t idx) const {
+    if (layout_ == PgasLayout::kBlockCyclic) {
+      return std::min((idx / block_ + 1) * block_, max_size_);
+    }
+    if (splits_.empty()) {
+      return max_size_;
+    }
+    return splits_[OwnerOf(idx) + 1];
+  }
+
+  /**
+   * The span [off, off + size) of a rank's region. For block-cyclic
+   * layouts this covers other ranks' blocks too; use RangesOf instead.
+   * */
+  std::pair<size_t, size_t> RegionOf(int rank) const {
+    if (layout_ == PgasLayout::kBlockCyclic) {
+      std::vector<std::pair<size_t, size_t>> ranges = RangesOf(rank);
+      if (ranges.empty()) {
+        return {max_size_, 0};
+      }
+      return {ranges.front().first,
+              ranges.back().first + ranges.back().second -
+                  ranges.front().first};
+    }
+    return {splits_[rank], splits_[rank + 1] - splits_[rank]};
+  }
+
+  /** The contiguous ranges (offset, size) owned by a rank */
+  std::vector<std::pair<size_t, size_t>> RangesOf(int rank) const {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (layout_ == PgasLayout::kBlockCyclic) {
+      for (size_t off = rank * block_; off < max_size_;
+           off += nprocs_ * block_) {
+        ranges.emplace_back(off, std::min(block_, max_size_ - off));
+      }
+    } else if (splits_[rank + 1] > splits_[rank]) {
+      ranges.emplace_back(splits_[rank], splits_[rank + 1] - splits_[rank]);
+    }
+    return ranges;
+  }
+
+  /** The contiguous ranges (offset, size) owned by this rank */
+  std::vector<std::pair<size_t, size_t>> LocalRanges() const {
+    return RangesOf(rank_);
+  }
+
+  /** Whether each rank owns a single contiguous range */
+  bool IsContiguous() const {
+    return layout_ != PgasLayout::kBlockCyclic;
   }
 };
 
@@ -0,0 +1,251 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_NODE_CACHE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_NODE_CACHE_H_
+
+#include <atomic>
+#include <functional>
+#include <new>
+#include <mpi.h>
+#include <sched.h>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+namespace mm {
+
+/** A page slot of the node cache (lives in shared memory) */
+struct NodeCacheSlot {
+  std::atomic<u64> path_;     /**< Hash of the vector path (0 if empty) */
+  std::atomic<u64> epoch_;    /**< Read-only epoch the page belongs to */
+  std::atomic<u64> page_;     /**< Page index within the vector */
+  std::atomic<u32> ready_;    /**< The page has been faulted */
+  std::atomic<u32> refcnt_;   /**< Number of ranks mapping the page */
+  std::atomic<u64> used_;     /**< Tick of the last acquire (for LRU) */
+};
+
+/** Header of the node cache (lives in shared memory) */
+struct NodeCacheHeader {
+  std::atomic<u32> lock_;     /**< Guards slot lookup and replacement */
+  std::atomic<u64> tick_;     /**< Logical clock for LRU */
+  size_t num_slots_;          /**< Number of slots */
+  size_t slot_size_;          /**< Max bytes of a page */
+};
+
+/**
+ * A node-level cache of read-only pages shared by every rank on a node.
+ * A page is faulted by the first rank which acquires it and then mapped
+ * by every other rank, so node memory use no longer grows with the
+ * number of ranks per node. Pages are keyed by vector path, read-only
+ * epoch, and page index.
+ * */
+class NodeCache {
+ public:
+  MPI_Comm node_comm_ = MPI_COMM_NULL;  /**< Ranks sharing this node */
+  MPI_Win win_ = MPI_WIN_NULL;          /**< The shared segment */
+  int node_rank_ = 0;                   /**< Rank within the node */
+  int node_nprocs_ = 1;                 /**< Ranks on this node */
+  NodeCacheHeader *header_ = nullptr;   /**< Cache header */
+  NodeCacheSlot *slots_ = nullptr;      /**< Slot table */
+  char *pages_ = nullptr;               /**< Page frames */
+
+ public:
+  /** Get the per-process cache */
+  static NodeCache* GetInstance() {
+    static NodeCache cache;
+    return &cache;
+  }
+
+  /** Whether the cache has been created */
+  bool IsInitialized() const {
+    return header_ != nullptr;
+  }
+
+  /**
+   * Create the cache (collective over comm)
+   *
+   * @param comm The ranks which may share pages
+   * @param capacity The bytes of pages to keep per node
+   * @param slot_size The max size of a shared page
+   * */
+  void Init(MPI_Comm comm, size_t capacity,
+            size_t slot_size = MM_PAGE_SIZE) {
+    if (IsInitialized()) {
+      return;
+    }
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0,
+                        MPI_INFO_NULL, &node_comm_);
+    MPI_Comm_rank(node_comm_, &node_rank_);
+    MPI_Comm_size(node_comm_, &node_nprocs_);
+    size_t num_slots = capacity / slot_size;
+    size_t meta_size = sizeof(NodeCacheHeader) +
+        num_slots * sizeof(NodeCacheSlot);
+    meta_size = (meta_size + 63) / 64 * 64;
+    size_t total = node_rank_ == 0 ? meta_size + num_slots * slot_size : 0;
+    char *base;
+    MPI_Win_allocate_shared(total, 1, MPI_INFO_NULL, node_comm_,
+                            &base, &win_);
+    MPI_Aint size;
+    int disp;
+    MPI_Win_shared_query(win_, 0, &size, &disp, &base);
+    header_ = reinterpret_cast<NodeCacheHeader*>(base);
+    slots_ = reinterpret_cast<NodeCacheSlot*>(header_ + 1);
+    pages_ = base + meta_size;
+    if (node_rank_ == 0) {
+      new (header_) NodeCacheHeader();
+      header_->lock_ = 0;
+      header_->tick_ = 0;
+      header_->num_slots_ = num_slots;
+      header_->slot_size_ = slot_size;
+      for (size_t i = 0; i < num_slots; ++i) {
+        new (slots_ + i) NodeCacheSlot();
+        slots_[i].path_ = 0;
+        slots_[i].epoch_ = 0;
+        slots_[i].page_ = 0;
+        slots_[i].ready_ = 0;
+        slots_[i].refcnt_ = 0;
+        slots_[i].used_ = 0;
+      }
+    }
+    MPI_Barrier(node_comm_);
+    HILOG(kInfo, "Node cache of {} slots of {} bytes over {} ranks",
+          num_slots, slot_size, node_nprocs_);
+  }
+
+  /** Destroy the cache (collective, before MPI_Finalize) */
+  void Finalize() {
+    if (!IsInitialized()) {
+      return;
+    }
+    MPI_Barrier(node_comm_);
+    MPI_Win_free(&win_);
+    MPI_Comm_free(&node_comm_);
+    header_ = nullptr;
+    slots_ = nullptr;
+    pages_ = nullptr;
+  }
+
+  /** Whether a page of this size can be shared */
+  bool Fits(size_t page_size) const {
+    return IsInitialized() && page_size <= header_->slot_size_;
+  }
+
+  /** Hash a vector path into a cache key (never 0) */
+  static u64 HashPath(const std::string &path) {
+    u64 hash = std::hash<std::string>{}(path);
+    return hash ? hash : 1;
+  }
+
+  /**
+   * Map a page. The first rank to acquire a page calls fill to fault
+   * it into the shared frame; other ranks wait until it is ready.
+   *
+   * @return The page frame, or nullptr if every slot is in use
+   * */
+  char* Acquire(u64 path, u64 epoch, size_t page_idx, int &slot,
+                const std::function<void(char*)> &fill) {
+    Lock();
+    u64 tick = header_->tick_++;
+    slot = Find(path, epoch, page_idx);
+    if (slot >= 0) {
+      NodeCacheSlot &hit = slots_[slot];
+      hit.refcnt_ += 1;
+      hit.used_ = tick;
+      Unlock();
+      while (!hit.ready_.load(std::memory_order_acquire)) {
+        sched_yield();
+      }
+      return Frame(slot);
+    }
+    slot = Victim();
+    if (slot < 0) {
+      Unlock();
+      return nullptr;
+    }
+    NodeCacheSlot &miss = slots_[slot];
+    miss.path_ = path;
+    miss.epoch_ = epoch;
+    miss.page_ = page_idx;
+    miss.ready_ = 0;
+    miss.refcnt_ = 1;
+    miss.used_ = tick;
+    Unlock();
+    fill(Frame(slot));
+    miss.ready_.store(1, std::memory_order_release);
+    return Frame(slot);
+  }
+
+  /** Unmap a page */
+  void Release(int slot) {
+    slots_[slot].refcnt_ -= 1;
+  }
+
+  /**
+   * Drop the pages of a vector from epochs before the given one.
+   * Ranks still mapping a dropped page keep it until they release it.
+   * */
+  void Invalidate(u64 path, u64 epoch) {
+    Lock();
+    for (size_t i = 0; i < header_->num_slots_; ++i) {
+      NodeCacheSlot &slot = slots_[i];
+      if (slot.path_ == path && slot.epoch_ < epoch) {
+        slot.path_ = 0;
+      }
+    }
+    Unlock();
+  }
+
+ private:
+  /** Find a ready or loading page */
+  int Find(u64 path, u64 epoch, size_t page_idx) {
+    for (size_t i = 0; i < header_->num_slots_; ++i) {
+      NodeCacheSlot &slot = slots_[i];
+      if (slot.path_ == path && slot.epoch_ == epoch &&
+          slot.page_ == page_idx) {
+        return (int)i;
+      }
+    }
+    return -1;
+  }
+
+  /** Find the least-recently used slot no rank maps */
+  int Victim() {
+    int victim = -1;
+    u64 min_used = 0;
+    for (size_t i = 0; i < header_->num_slots_; ++i) {
+      NodeCacheSlot &slot = slots_[i];
+      if (slot.refcnt_ != 0) {
+        continue;
+      }
+      if (slot.path_ == 0) {
+        return (int)i;
+      }
+      if (victim < 0 || slot.used_ < min_used) {
+        victim = (int)i;
+        min_used = slot.used_;
+      }
+    }
+    return victim;
+  }
+
+  /** The frame of a slot */
+  char* Frame(int slot) {
+    return pages_ + slot * header_->slot_size_;
+  }
+
+  /** Acquire the cache lock */
+  void Lock() {
+    while (header_->lock_.exchange(1, std::memory_order_acquire)) {
+      sched_yield();
+    }
+  }
+
+  /** Release the cache lock */
+  void Unlock() {
+    header_->lock_.store(0, std::memory_order_release);
+  }
+};
+
+}  // namespace mm
+
+/** Singleton macro for the node cache */
+#define MM_NODE_CACHE mm::NodeCache::GetInstance()
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_NODE_CACHE_H_
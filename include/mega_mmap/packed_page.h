@@ -0,0 +1,113 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_PACKED_PAGE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_PACKED_PAGE_H_
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cereal/archives/binary.hpp>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+namespace mm {
+
+/** Header of a packed page */
+struct PackedPageHeader {
+  u64 count_;       /**< Number of elements in the page */
+  u64 in_primary_;  /**< Element bytes kept in the primary blob */
+};
+
+/**
+ * A page of serialized (cereal) elements of variable length.
+ * The primary blob holds the header, an offset table of count + 1
+ * entries, and the element bytes. Element i occupies bytes
+ * [offs[i], offs[i + 1]). Once a page outgrows the page size, the
+ * bytes past in_primary_ are kept in an overflow blob, so the primary
+ * blob stays page-sized for tier placement.
+ * */
+template<typename T>
+class PackedPage {
+ public:
+  /** Bytes of the header and offset table */
+  static size_t MetaSize(size_t count) {
+    return sizeof(PackedPageHeader) + (count + 1) * sizeof(u64);
+  }
+
+  /**
+   * Serialize elements into a primary and an overflow buffer
+   *
+   * @param page_size The target size of the primary buffer
+   * @return Whether the page overflows
+   * */
+  static bool Pack(const T *elmts, size_t count, size_t page_size,
+                   std::string &primary, std::string &overflow) {
+    std::vector<u64> offs(count + 1, 0);
+    std::stringstream ss;
+    {
+      cereal::BinaryOutputArchive ar(ss);
+      for (size_t i = 0; i < count; ++i) {
+        ar(elmts[i]);
+        offs[i + 1] = (u64)ss.tellp();
+      }
+    }
+    std::string bytes = ss.str();
+    size_t meta_size = MetaSize(count);
+    size_t room = page_size > meta_size ? page_size - meta_size : 0;
+    PackedPageHeader hdr;
+    hdr.count_ = count;
+    hdr.in_primary_ = std::min<size_t>(bytes.size(), room);
+    primary.resize(meta_size + hdr.in_primary_);
+    memcpy(primary.data(), &hdr, sizeof(hdr));
+    memcpy(primary.data() + sizeof(hdr), offs.data(),
+           offs.size() * sizeof(u64));
+    memcpy(primary.data() + meta_size, bytes.data(), hdr.in_primary_);
+    overflow.assign(bytes, hdr.in_primary_, std::string::npos);
+    return !overflow.empty();
+  }
+
+  /** Whether a primary buffer has bytes in an overflow blob */
+  static bool Overflows(const char *primary, size_t size) {
+    if (size < sizeof(PackedPageHeader)) {
+      return false;
+    }
+    PackedPageHeader hdr;
+    memcpy(&hdr, primary, sizeof(hdr));
+    const u64 *offs = reinterpret_cast<const u64*>(primary + sizeof(hdr));
+    return offs[hdr.count_] > hdr.in_primary_;
+  }
+
+  /**
+   * Deserialize up to count elements
+   *
+   * @return The number of elements stored in the page
+   * */
+  static size_t Unpack(const char *primary, size_t size,
+                       const std::string &overflow,
+                       T *elmts, size_t count) {
+    if (size < sizeof(PackedPageHeader)) {
+      return 0;
+    }
+    PackedPageHeader hdr;
+    memcpy(&hdr, primary, sizeof(hdr));
+    size_t meta_size = MetaSize(hdr.count_);
+    const u64 *offs = reinterpret_cast<const u64*>(primary + sizeof(hdr));
+    std::string bytes(primary + meta_size, hdr.in_primary_);
+    bytes += overflow;
+    if (bytes.size() < offs[hdr.count_]) {
+      HELOG(kError, "Packed page has {} of {} bytes",
+            bytes.size(), offs[hdr.count_]);
+      return 0;
+    }
+    count = std::min<size_t>(count, hdr.count_);
+    std::stringstream ss(std::move(bytes));
+    cereal::BinaryInputArchive ar(ss);
+    for (size_t i = 0; i < count; ++i) {
+      ar(elmts[i]);
+    }
+    return hdr.count_;
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_PACKED_PAGE_H_
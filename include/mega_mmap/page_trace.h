@@ -0,0 +1,215 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_PAGE_TRACE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_PAGE_TRACE_H_
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+namespace mm {
+
+/** Kinds of page trace events */
+enum class PageTraceOp : u32 {
+  kRead,      /**< An access moved to a page */
+  kWrite,     /**< An access moved to a page, or first modified it */
+  kEvict,     /**< Rescore released elements (score < 1) */
+  kPrefetch,  /**< Rescore asked for elements ahead of use (score == 1) */
+  kDefine     /**< Declares a vector (its name follows the record) */
+};
+
+/**
+ * A page trace record. Elements are recorded instead of pages, so a
+ * trace can be replayed with other page sizes. For kDefine, idx_ is
+ * the element size and count_ the length of the name.
+ * */
+struct PageTraceRecord {
+  u32 vec_;     /**< Vector id (from kDefine) */
+  u32 op_;      /**< PageTraceOp */
+  u64 idx_;     /**< First element of the event */
+  u64 count_;   /**< Number of elements of the event */
+  u64 tx_;      /**< Transaction number in the vector (0 outside of one) */
+  u64 ns_;      /**< Nanoseconds since the trace began */
+};
+
+/** A vector declared in a page trace */
+struct PageTraceVector {
+  std::string name_;
+  size_t elmt_size_;
+};
+
+/**
+ * Records page transitions of operator[] and Rescore events of every
+ * vector in the process. Opt-in: tracing is enabled by setting
+ * MM_PAGE_TRACE to a path prefix, and each rank writes
+ * {prefix}.{rank}.mmt. Records are buffered and written in blocks.
+ * */
+class PageTracer {
+ public:
+  static constexpr u64 kMagic = 0x3145434152544d4dull;  /**< "MMTRACE1" */
+  static constexpr size_t kBufRecords = 65536;
+
+ public:
+  std::mutex lock_;
+  std::string prefix_;
+  FILE *file_ = nullptr;
+  std::vector<PageTraceRecord> buf_;
+  u32 num_vecs_ = 0;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  PageTracer() {
+    const char *prefix = std::getenv("MM_PAGE_TRACE");
+    if (prefix) {
+      prefix_ = prefix;
+    }
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  ~PageTracer() {
+    Close();
+  }
+
+  /** Get the per-process tracer */
+  static PageTracer* GetInstance() {
+    static PageTracer tracer;
+    return &tracer;
+  }
+
+  /** Whether MM_PAGE_TRACE is set */
+  bool IsEnabled() const {
+    return !prefix_.empty();
+  }
+
+  /**
+   * Declare a vector
+   *
+   * @return The id of the vector in the trace (-1 if not tracing)
+   * */
+  int Define(const std::string &name, size_t elmt_size) {
+    if (!IsEnabled()) {
+      return -1;
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!file_ && !_Open()) {
+      return -1;
+    }
+    u32 id = num_vecs_++;
+    _Flush();
+    PageTraceRecord rec{id, (u32)PageTraceOp::kDefine,
+                        elmt_size, name.size(), 0, _Now()};
+    fwrite(&rec, sizeof(rec), 1, file_);
+    fwrite(name.data(), 1, name.size(), file_);
+    return (int)id;
+  }
+
+  /** Record an event of a vector */
+  void Record(int vec, PageTraceOp op, size_t idx, size_t count, u64 tx) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!file_) {
+      return;
+    }
+    buf_.emplace_back(PageTraceRecord{(u32)vec, (u32)op, idx, count,
+                                      tx, _Now()});
+    if (buf_.size() == kBufRecords) {
+      _Flush();
+    }
+  }
+
+  /** Write buffered records */
+  void Flush() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (file_) {
+      _Flush();
+      fflush(file_);
+    }
+  }
+
+  /** Write buffered records and close the trace */
+  void Close() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (file_) {
+      _Flush();
+      fclose(file_);
+      file_ = nullptr;
+    }
+  }
+
+  /** Open the trace of this rank */
+  bool _Open() {
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    std::string path = hshm::Formatter::format("{}.{}.mmt", prefix_, rank);
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+      HELOG(kError, "Could not open the page trace {}", path);
+      prefix_.clear();
+      return false;
+    }
+    fwrite(&kMagic, sizeof(kMagic), 1, file_);
+    buf_.reserve(kBufRecords);
+    return true;
+  }
+
+  /** Write buffered records (lock held) */
+  void _Flush() {
+    fwrite(buf_.data(), sizeof(PageTraceRecord), buf_.size(), file_);
+    buf_.clear();
+  }
+
+  /** Nanoseconds since the trace began */
+  u64 _Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+  }
+};
+
+/** Reads the trace of a rank */
+class PageTraceReader {
+ public:
+  std::vector<PageTraceVector> vecs_;   /**< Vectors by id */
+  std::vector<PageTraceRecord> recs_;   /**< Events, in order */
+
+ public:
+  /** Read a trace file, returning false if it is not a page trace */
+  bool Read(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+      return false;
+    }
+    u64 magic = 0;
+    if (fread(&magic, sizeof(magic), 1, file) != 1 ||
+        magic != PageTracer::kMagic) {
+      fclose(file);
+      HELOG(kError, "{} is not a page trace", path);
+      return false;
+    }
+    PageTraceRecord rec;
+    while (fread(&rec, sizeof(rec), 1, file) == 1) {
+      if (rec.op_ != (u32)PageTraceOp::kDefine) {
+        recs_.emplace_back(rec);
+        continue;
+      }
+      std::string name(rec.count_, 0);
+      if (fread(name.data(), 1, name.size(), file) != name.size()) {
+        break;
+      }
+      if (vecs_.size() <= rec.vec_) {
+        vecs_.resize(rec.vec_ + 1);
+      }
+      vecs_[rec.vec_] = PageTraceVector{name, rec.idx_};
+    }
+    fclose(file);
+    return true;
+  }
+};
+
+}  // namespace mm
+
+#define MM_PAGE_TRACE mm::PageTracer::GetInstance()
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_PAGE_TRACE_H_
@@ -0,0 +1,181 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_PAGE_TUNER_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_PAGE_TUNER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include "hermes_shm/util/logging.h"
+#include "hermes/hermes.h"
+#include "macros.h"
+
+namespace mm {
+
+/** The page size chosen for a vector and the inputs it was derived from */
+struct PageTuning {
+  u32 pattern_ = 0;          /**< Declared access pattern (MM_*_ACCESS) */
+  size_t elmt_size_ = 0;     /**< Size of a single element */
+  size_t window_size_ = 0;   /**< Memory bound of the vector */
+  size_t count_ = 0;         /**< Number of elements in the vector */
+  double latency_ = 0;       /**< Backend latency (seconds per access) */
+  double bandwidth_ = 0;     /**< Backend bandwidth (bytes per second) */
+  size_t page_size_ = 0;     /**< The chosen page size */
+
+  /** Describe the pick, so it can be reproduced with SetPageSize */
+  std::string ToString() const {
+    return hshm::Formatter::format(
+        "page_size={} pattern={} elmt_size={} window_size={} count={} "
+        "latency={}us bandwidth={}MBps",
+        page_size_, PatternName(), elmt_size_, window_size_, count_,
+        latency_ * 1e6, bandwidth_ / MEGABYTES(1));
+  }
+
+  /** Name of the declared access pattern */
+  const char* PatternName() const {
+    if (pattern_ & MM_SEQ_ACCESS) {
+      return "seq";
+    } else if (pattern_ & MM_RAND_ACCESS) {
+      return "rand";
+    } else if (pattern_ & MM_PGAS_ACCESS) {
+      return "pgas";
+    }
+    return "none";
+  }
+};
+
+static_assert(std::is_trivially_copyable<PageTuning>::value,
+              "PageTuning is broadcast as bytes");
+
+/**
+ * Chooses a page size from the access pattern, element size, window size,
+ * and the latency / bandwidth of the backend.
+ * */
+class PageTuner {
+ public:
+  static constexpr size_t kMinPageSize = KILOBYTES(4);
+  static constexpr size_t kMaxPageSize = MEGABYTES(64);
+  static constexpr size_t kSeqPagesPerWindow = 8;
+  static constexpr size_t kRandPagesPerWindow = 64;
+  static constexpr size_t kSmallProbe = KILOBYTES(4);
+  static constexpr size_t kLargeProbe = MEGABYTES(4);
+  static constexpr int kProbeReps = 8;
+  static constexpr double kMinProbeSec = 1e-9;
+
+ public:
+  /** Tune the page size of a vector */
+  static PageTuning Tune(const std::string &path, u32 pattern,
+                         size_t elmt_size, size_t window_size,
+                         size_t count) {
+    PageTuning tuning;
+    tuning.pattern_ = pattern;
+    tuning.elmt_size_ = elmt_size;
+    tuning.window_size_ = window_size;
+    tuning.count_ = count;
+    Probe(path, tuning.latency_, tuning.bandwidth_);
+    tuning.page_size_ = Choose(tuning);
+    return tuning;
+  }
+
+  /**
+   * Measure backend latency and bandwidth. The probe is only run
+   * once per process, since every vector shares the same backend.
+   * The probe blobs are demoted to the lowest tier before they are
+   * timed, so the timings are of the backend rather than of DRAM.
+   * Only one rank of a vector's communicator should probe (see
+   * VectorMegaMpi::AutoPageSize), since the probe bucket is shared.
+   * */
+  static void Probe(const std::string &path,
+                    double &latency, double &bandwidth) {
+    static double cached_latency = 0, cached_bandwidth = 0;
+    if (cached_bandwidth == 0) {
+      hermes::Context ctx;
+      hermes::Bucket bkt = HERMES->GetBucket(path + "_probe", ctx);
+      hermes::Blob small(kSmallProbe), large(kLargeProbe);
+      memset(small.data(), 0, small.size());
+      memset(large.data(), 0, large.size());
+      bkt.Put("small", small, ctx);
+      bkt.Put("large", large, ctx);
+      bkt.ReorganizeBlob("small", 0, ctx);
+      bkt.ReorganizeBlob("large", 0, ctx);
+      HRUN_ADMIN->FlushRoot(DomainId::GetLocal());
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < kProbeReps; ++i) {
+        bkt.Get("small", small, ctx);
+      }
+      auto mid = std::chrono::steady_clock::now();
+      for (int i = 0; i < kProbeReps; ++i) {
+        bkt.Get("large", large, ctx);
+      }
+      auto end = std::chrono::steady_clock::now();
+      bkt.Destroy();
+      double small_sec = std::max(
+          std::chrono::duration<double>(mid - start).count() / kProbeReps,
+          kMinProbeSec);
+      double large_sec = std::max(
+          std::chrono::duration<double>(end - mid).count() / kProbeReps,
+          kMinProbeSec);
+      cached_latency = small_sec;
+      if (large_sec > small_sec) {
+        cached_bandwidth = (kLargeProbe - kSmallProbe) /
+            (large_sec - small_sec);
+      } else {
+        cached_bandwidth = kLargeProbe / large_sec;
+      }
+    }
+    latency = cached_latency;
+    bandwidth = cached_bandwidth;
+  }
+
+  /**
+   * Pick the page size. The break-even size is the number of bytes
+   * which can be transferred in the time of a single backend access.
+   * Sequential scans amortize latency over several break-even sizes.
+   * Random and PGAS accesses keep pages near break-even, so that
+   * little unused data is read per fault. Small vectors fit in one page.
+   * */
+  static size_t Choose(const PageTuning &tuning) {
+    size_t elmt_size = tuning.elmt_size_;
+    size_t total = tuning.count_ * elmt_size;
+    size_t breakeven = (size_t)(tuning.latency_ * tuning.bandwidth_);
+    size_t page_size;
+    size_t pages_per_window;
+    if (tuning.pattern_ & MM_SEQ_ACCESS) {
+      page_size = 4 * breakeven;
+      pages_per_window = kSeqPagesPerWindow;
+    } else if (tuning.pattern_ & MM_RAND_ACCESS) {
+      page_size = breakeven;
+      pages_per_window = kRandPagesPerWindow;
+    } else {
+      page_size = breakeven;
+      pages_per_window = kSeqPagesPerWindow;
+    }
+    // Keep enough pages in the window for prefetching and eviction
+    if (tuning.window_size_) {
+      page_size = std::min(page_size,
+                           tuning.window_size_ / pages_per_window);
+    }
+    page_size = std::max(page_size, kMinPageSize);
+    page_size = std::min(page_size, kMaxPageSize);
+    page_size = RoundDownPow2(page_size);
+    // Vectors which are about a page in size get exactly one page
+    if (total && total <= 2 * page_size) {
+      page_size = total;
+    }
+    // A page holds at least one element
+    page_size = std::max(page_size / elmt_size, (size_t)1) * elmt_size;
+    return page_size;
+  }
+
+  /** Round down to the nearest power of two */
+  static size_t RoundDownPow2(size_t val) {
+    size_t pow2 = 1;
+    while (pow2 * 2 <= val) {
+      pow2 *= 2;
+    }
+    return pow2;
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_PAGE_TUNER_H_
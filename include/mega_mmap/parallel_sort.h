@@ -0,0 +1,51 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_PARALLEL_SORT_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_PARALLEL_SORT_H_
+
+#include <algorithm>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace mm {
+
+/**
+ * Sort [first, last) with OpenMP threads. Each thread sorts an equal
+ * slice, and the slices are then merged pairwise in log2(threads)
+ * rounds. Falls back to std::sort without OpenMP or for small ranges.
+ * */
+template<typename T>
+void ParallelSort(T *first, T *last) {
+  size_t count = last - first;
+  int nthreads = 1;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  if (nthreads <= 1 || count < (size_t)nthreads * 4096) {
+    std::sort(first, last);
+    return;
+  }
+  std::vector<size_t> bounds(nthreads + 1);
+  for (int i = 0; i <= nthreads; ++i) {
+    bounds[i] = count * i / nthreads;
+  }
+#pragma omp parallel for
+  for (int i = 0; i < nthreads; ++i) {
+    std::sort(first + bounds[i], first + bounds[i + 1]);
+  }
+  for (int width = 1; width < nthreads; width *= 2) {
+#pragma omp parallel for
+    for (int i = 0; i < nthreads; i += 2 * width) {
+      if (i + width < nthreads) {
+        int end = std::min(i + 2 * width, nthreads);
+        std::inplace_merge(first + bounds[i],
+                           first + bounds[i + width],
+                           first + bounds[end]);
+      }
+    }
+  }
+}
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_PARALLEL_SORT_H_
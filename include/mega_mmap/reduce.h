@@ -0,0 +1,77 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_REDUCE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_REDUCE_H_
+
+#include <mpi.h>
+#include <vector>
+
+namespace mm {
+
+/**
+ * MPI reductions of plain element types with an arbitrary binary
+ * operator (e.g., a lambda). The operator must be associative and
+ * commutative, since MPI may combine partial results in any order.
+ * */
+template<typename T, typename OpT>
+class MpiReduce {
+ public:
+  static inline OpT *op_ = nullptr;  /**< The operator of the current call */
+
+ public:
+  /** Elementwise reduce vals across ranks, storing the result on each */
+  static void AllReduce(T *vals, size_t count, OpT &op, MPI_Comm comm) {
+    MPI_Datatype type = Begin(op);
+    MPI_Op mpi_op = CreateOp();
+    MPI_Allreduce(MPI_IN_PLACE, vals, (int)count, type, mpi_op, comm);
+    End(type, mpi_op);
+  }
+
+  /**
+   * Elementwise reduce vals across ranks, leaving rank i only the
+   * counts[i] results which start at the sum of the earlier counts
+   * */
+  static void ReduceScatter(const T *vals, T *out,
+                            const std::vector<int> &counts,
+                            OpT &op, MPI_Comm comm) {
+    MPI_Datatype type = Begin(op);
+    MPI_Op mpi_op = CreateOp();
+    MPI_Reduce_scatter(vals, out, counts.data(), type, mpi_op, comm);
+    End(type, mpi_op);
+  }
+
+ private:
+  /** The MPI form of the operator: inout[i] = in[i] op inout[i] */
+  static void Combine(void *in, void *inout, int *len, MPI_Datatype *type) {
+    T *a = reinterpret_cast<T*>(in);
+    T *b = reinterpret_cast<T*>(inout);
+    for (int i = 0; i < *len; ++i) {
+      b[i] = (*op_)(a[i], b[i]);
+    }
+  }
+
+  /** Register the operator and the element type */
+  static MPI_Datatype Begin(OpT &op) {
+    op_ = &op;
+    MPI_Datatype type;
+    MPI_Type_contiguous(sizeof(T), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    return type;
+  }
+
+  /** Create the MPI operator */
+  static MPI_Op CreateOp() {
+    MPI_Op mpi_op;
+    MPI_Op_create(&Combine, 1, &mpi_op);
+    return mpi_op;
+  }
+
+  /** Free the MPI operator and the element type */
+  static void End(MPI_Datatype &type, MPI_Op &mpi_op) {
+    MPI_Op_free(&mpi_op);
+    MPI_Type_free(&type);
+    op_ = nullptr;
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_REDUCE_H_
@@ -0,0 +1,119 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_RMA_WINDOW_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_RMA_WINDOW_H_
+
+#include <mpi.h>
+#include <vector>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+namespace mm {
+
+/**
+ * Exposes the resident pages of a rank's PGAS region to other ranks
+ * through MPI-3 RMA. A directory window maps each owned page to its
+ * address in a dynamic window, or 0 if the page is not resident.
+ * Pages are published for the duration of a read-only epoch.
+ * */
+class RmaWindow {
+ public:
+  MPI_Comm comm_ = MPI_COMM_NULL;   /**< Ranks sharing the vector */
+  MPI_Win dir_win_ = MPI_WIN_NULL;  /**< Directory of page addresses */
+  MPI_Win page_win_ = MPI_WIN_NULL; /**< Dynamic window of pages */
+  MPI_Aint *dir_ = nullptr;         /**< Local directory */
+  size_t first_page_ = 0;           /**< First page of the local region */
+  size_t num_pages_ = 0;            /**< Pages of the local region */
+  std::vector<char*> attached_;     /**< Pages attached to page_win_ */
+
+ public:
+  /** Whether the windows exist */
+  bool IsInitialized() const {
+    return comm_ != MPI_COMM_NULL;
+  }
+
+  /** Create the windows (collective) */
+  void Init(MPI_Comm comm, size_t first_page, size_t num_pages) {
+    comm_ = comm;
+    first_page_ = first_page;
+    num_pages_ = num_pages;
+    MPI_Win_allocate(num_pages * sizeof(MPI_Aint), sizeof(MPI_Aint),
+                     MPI_INFO_NULL, comm, &dir_, &dir_win_);
+    for (size_t i = 0; i < num_pages; ++i) {
+      dir_[i] = 0;
+    }
+    MPI_Win_create_dynamic(MPI_INFO_NULL, comm, &page_win_);
+    MPI_Win_lock_all(0, dir_win_);
+    MPI_Win_lock_all(0, page_win_);
+    MPI_Barrier(comm);
+  }
+
+  /** Free the windows (collective) */
+  void Finalize() {
+    if (!IsInitialized()) {
+      return;
+    }
+    Unpublish();
+    MPI_Win_unlock_all(page_win_);
+    MPI_Win_unlock_all(dir_win_);
+    MPI_Win_free(&page_win_);
+    MPI_Win_free(&dir_win_);
+    comm_ = MPI_COMM_NULL;
+  }
+
+  /** Expose a resident page of the local region */
+  void Publish(size_t page_idx, char *data, size_t size) {
+    if (page_idx < first_page_ || page_idx >= first_page_ + num_pages_) {
+      return;
+    }
+    MPI_Win_attach(page_win_, data, size);
+    MPI_Get_address(data, &dir_[page_idx - first_page_]);
+    attached_.emplace_back(data);
+  }
+
+  /** Make published pages visible to other ranks */
+  void Sync() {
+    MPI_Win_sync(dir_win_);
+    MPI_Win_sync(page_win_);
+  }
+
+  /** Withdraw all published pages */
+  void Unpublish() {
+    for (char *data : attached_) {
+      MPI_Win_detach(page_win_, data);
+    }
+    attached_.clear();
+    for (size_t i = 0; i < num_pages_; ++i) {
+      dir_[i] = 0;
+    }
+    MPI_Win_sync(dir_win_);
+  }
+
+  /**
+   * Read part of a page published by another rank
+   *
+   * @param owner The rank owning the page
+   * @param owner_first_page The first page of the owner's region
+   * @param page_idx The page to read
+   * @param off The byte offset within the page
+   * @param size The number of bytes to read
+   * @param buf Where to read the bytes to
+   * @return false if the owner does not have the page resident
+   * */
+  bool Fetch(int owner, size_t owner_first_page, size_t page_idx,
+             size_t off, size_t size, char *buf) {
+    MPI_Aint addr = 0;
+    MPI_Get(&addr, 1, MPI_AINT, owner,
+            page_idx - owner_first_page, 1, MPI_AINT, dir_win_);
+    MPI_Win_flush(owner, dir_win_);
+    if (addr == 0) {
+      return false;
+    }
+    MPI_Get(buf, (int)size, MPI_BYTE, owner,
+            MPI_Aint_add(addr, off), (int)size, MPI_BYTE, page_win_);
+    MPI_Win_flush(owner, page_win_);
+    return true;
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_RMA_WINDOW_H_
@@ -0,0 +1,177 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_SCHEDULER_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_SCHEDULER_H_
+
+#include <algorithm>
+#include <mpi.h>
+#include <vector>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+namespace mm {
+
+/**
+ * Hands out page-granular chunks of a vector range with work stealing.
+ * Each rank starts with an even share of the chunks. A counter per rank,
+ * kept in an RMA window, is advanced with MPI_Fetch_and_op by the owner
+ * and by thieves alike. Once a rank drains its own chunks, it steals from
+ * ranks on the same node first (whose pages are likely in the node's
+ * tiers), and then from remote ranks.
+ * */
+class ChunkScheduler {
+ public:
+  MPI_Comm comm_ = MPI_COMM_NULL;  /**< Ranks sharing the range */
+  MPI_Win win_ = MPI_WIN_NULL;     /**< Next chunk of each rank */
+  u64 *next_ = nullptr;            /**< Local next chunk */
+  int rank_ = 0;                   /**< Rank in comm_ */
+  int nprocs_ = 1;                 /**< Ranks in comm_ */
+  size_t off_ = 0;                 /**< First element of the range */
+  size_t size_ = 0;                /**< Elements in the range */
+  size_t chunk_size_ = 1;          /**< Elements per chunk */
+  size_t first_chunk_ = 0;         /**< Index of the first chunk */
+  size_t num_chunks_ = 0;          /**< Chunks in the range */
+  std::vector<u64> ends_;          /**< One past the last chunk of a rank */
+  std::vector<int> victims_;       /**< Steal order */
+  size_t victim_ = 0;              /**< Current index in victims_ */
+  size_t stolen_ = 0;              /**< Chunks taken from other ranks */
+
+ public:
+  /**
+   * Create the work queues (collective)
+   *
+   * @param comm The ranks which process the range
+   * @param off The first element of the range
+   * @param size The number of elements in the range
+   * @param chunk_size Elements per chunk (e.g., elements per page).
+   * Chunks are aligned to multiples of chunk_size.
+   * */
+  void Init(MPI_Comm comm, size_t off, size_t size, size_t chunk_size) {
+    comm_ = comm;
+    MPI_Comm_rank(comm, &rank_);
+    MPI_Comm_size(comm, &nprocs_);
+    off_ = off;
+    size_ = size;
+    chunk_size_ = std::max<size_t>(chunk_size, 1);
+    size_t first = off / chunk_size_;
+    size_t last = size ? (off + size - 1) / chunk_size_ + 1 : first;
+    first_chunk_ = first;
+    num_chunks_ = last - first;
+    // Even initial split of chunks
+    ends_.resize(nprocs_);
+    Bounds bounds;
+    for (int i = 0; i < nprocs_; ++i) {
+      bounds.EvenSplit(i, nprocs_, num_chunks_);
+      ends_[i] = bounds.off_ + bounds.size_;
+    }
+    bounds.EvenSplit(rank_, nprocs_, num_chunks_);
+    MPI_Win_allocate(sizeof(u64), sizeof(u64), MPI_INFO_NULL,
+                     comm, &next_, &win_);
+    *next_ = bounds.off_;
+    MPI_Win_lock_all(0, win_);
+    MPI_Barrier(comm);
+    FindVictims();
+  }
+
+  /** Steal from ranks on this node first, then from the others */
+  void FindVictims() {
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm_, MPI_COMM_TYPE_SHARED, 0,
+                        MPI_INFO_NULL, &node_comm);
+    int node_nprocs;
+    MPI_Comm_size(node_comm, &node_nprocs);
+    std::vector<int> is_local(nprocs_, 0);
+    {
+      MPI_Group group, node_group;
+      MPI_Comm_group(comm_, &group);
+      MPI_Comm_group(node_comm, &node_group);
+      std::vector<int> node_ranks(node_nprocs), ranks(node_nprocs);
+      for (int i = 0; i < node_nprocs; ++i) {
+        node_ranks[i] = i;
+      }
+      MPI_Group_translate_ranks(node_group, node_nprocs, node_ranks.data(),
+                                group, ranks.data());
+      for (int rank : ranks) {
+        is_local[rank] = 1;
+      }
+      MPI_Group_free(&node_group);
+      MPI_Group_free(&group);
+    }
+    MPI_Comm_free(&node_comm);
+    victims_.clear();
+    victims_.emplace_back(rank_);
+    for (int pass = 1; pass >= 0; --pass) {
+      for (int i = 1; i < nprocs_; ++i) {
+        int victim = (rank_ + i) % nprocs_;
+        if (is_local[victim] == pass) {
+          victims_.emplace_back(victim);
+        }
+      }
+    }
+    victim_ = 0;
+  }
+
+  /**
+   * Claim the next chunk
+   *
+   * @return false once every chunk of the range has been claimed
+   * */
+  bool Next(size_t &off, size_t &size) {
+    while (victim_ < victims_.size()) {
+      int victim = victims_[victim_];
+      u64 one = 1, chunk;
+      MPI_Fetch_and_op(&one, &chunk, MPI_UINT64_T, victim, 0,
+                       MPI_SUM, win_);
+      MPI_Win_flush(victim, win_);
+      if (chunk < ends_[victim]) {
+        if (victim != rank_) {
+          ++stolen_;
+        }
+        size_t first = (first_chunk_ + chunk) * chunk_size_;
+        size_t last = first + chunk_size_;
+        off = std::max(first, off_);
+        size = std::min(last, off_ + size_) - off;
+        return true;
+      }
+      ++victim_;
+    }
+    return false;
+  }
+
+  /** Free the work queues (collective) */
+  void Finalize() {
+    if (comm_ == MPI_COMM_NULL) {
+      return;
+    }
+    MPI_Barrier(comm_);
+    MPI_Win_unlock_all(win_);
+    MPI_Win_free(&win_);
+    HILOG(kDebug, "{}: Stole {} chunks", rank_, stolen_);
+    comm_ = MPI_COMM_NULL;
+  }
+};
+
+/**
+ * Process the range [off, off + size) of a vector in page-sized chunks
+ * handed out by a work-stealing scheduler (collective). Each chunk is
+ * accessed in its own sequential transaction, and fn(off, size) is
+ * called for it.
+ *
+ * @param pages_per_chunk Pages claimed at a time
+ * */
+template<typename VecT, typename F>
+void ForEachChunk(VecT &vec, size_t off, size_t size, F &&fn,
+                  MPI_Comm comm, u32 flags = MM_READ_ONLY,
+                  size_t pages_per_chunk = 1) {
+  ChunkScheduler sched;
+  sched.Init(comm, off, size, vec.elmts_per_page_ * pages_per_chunk);
+  size_t chunk_off, chunk_size;
+  while (sched.Next(chunk_off, chunk_size)) {
+    vec.SeqTxBegin(chunk_off, chunk_size, flags);
+    fn(chunk_off, chunk_size);
+    vec.TxEnd();
+  }
+  sched.Finalize();
+}
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_SCHEDULER_H_
@@ -0,0 +1,374 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_ARROW_SOURCE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_ARROW_SOURCE_H_
+
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <list>
+#include <numeric>
+#include <unordered_map>
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/type_traits.h>
+#include <parquet/arrow/reader.h>
+#include "hermes_shm/util/logging.h"
+#include "data_source.h"
+
+namespace mm {
+
+/**
+ * Maps the row groups (or record batches) of a set of Arrow-readable
+ * files onto vector pages. Each element of T is built from a projection
+ * of the file columns, which must all have the Arrow type of ColT
+ * (checked when each file is opened). Null values are replaced by
+ * null_value_ (NaN for floating point columns).
+ * */
+template<typename T, typename ColT = float>
+class ArrowSource : public DataSource {
+ public:
+  typedef typename arrow::CTypeTraits<ColT>::ArrayType ArrayT;
+  typedef std::shared_future<std::shared_ptr<arrow::Table>> GroupFuture;
+  static constexpr int kNumCols = sizeof(T) / sizeof(ColT);
+  static_assert(sizeof(T) % sizeof(ColT) == 0,
+                "T must be made of ColT fields");
+
+  /** A row group (or record batch) of a file */
+  struct Group {
+    size_t file_;   /**< Index of the file in paths_ */
+    int idx_;       /**< Index of the group within the file */
+    size_t off_;    /**< First element of the group in the vector */
+    size_t count_;  /**< Number of elements in the group */
+  };
+
+ public:
+  std::vector<std::string> paths_;   /**< Files making up the vector */
+  std::vector<int> columns_;         /**< Projected column indices */
+  std::vector<Group> groups_;        /**< Groups in vector order */
+  std::unordered_map<size_t, GroupFuture> cache_;  /**< Decoded groups */
+  std::list<size_t> lru_;            /**< Order groups were decoded */
+  size_t max_groups_;                /**< Max groups kept decoded */
+  size_t size_ = 0;                  /**< Total number of elements */
+  ColT null_value_;                  /**< Value stored for nulls */
+
+ public:
+  ArrowSource(const std::vector<std::string> &paths,
+              const std::vector<int> &columns,
+              size_t max_groups)
+      : paths_(paths), max_groups_(std::max<size_t>(max_groups, 1)) {
+    if constexpr (std::numeric_limits<ColT>::has_quiet_NaN) {
+      null_value_ = std::numeric_limits<ColT>::quiet_NaN();
+    } else {
+      null_value_ = ColT();
+    }
+    columns_ = columns;
+    if (columns_.empty()) {
+      for (int i = 0; i < kNumCols; ++i) {
+        columns_.emplace_back(i);
+      }
+    }
+    if (columns_.size() != kNumCols) {
+      HELOG(kFatal, "Projected {} columns, but the element has {} fields",
+            columns_.size(), kNumCols);
+    }
+  }
+
+  virtual ~ArrowSource() = default;
+
+  /** Decode a single group (must be thread-safe) */
+  virtual std::shared_ptr<arrow::Table> ReadGroup(const Group &group) = 0;
+
+  /** Fail unless the projected columns of a file have the type of ColT */
+  void CheckSchema(const arrow::Schema &schema, const std::string &path) {
+    std::shared_ptr<arrow::DataType> type =
+        arrow::CTypeTraits<ColT>::type_singleton();
+    for (int col : columns_) {
+      if (col < 0 || col >= schema.num_fields()) {
+        HELOG(kFatal, "Column {} is out of range for {}", col, path);
+      }
+      const std::shared_ptr<arrow::Field> &field = schema.field(col);
+      if (!field->type()->Equals(*type)) {
+        HELOG(kFatal, "Column {} ({}) of {} is {}, expected {}",
+              col, field->name(), path,
+              field->type()->ToString(), type->ToString());
+      }
+    }
+  }
+
+  /** Append a group to the vector */
+  void AddGroup(size_t file, int idx, size_t count) {
+    groups_.emplace_back(Group{file, idx, size_, count});
+    size_ += count;
+  }
+
+  /** Number of elements in the source */
+  size_t Size() override {
+    return size_;
+  }
+
+  /**
+   * Pages never straddle groups, so a fault decodes a single group.
+   * Equal groups smaller than a page are packed whole into pages;
+   * otherwise pages split the groups evenly. Returns 0 (no preference)
+   * if the groups only share a divisor much smaller than a page.
+   * */
+  size_t PageElmts() override {
+    if (groups_.size() <= 1) {
+      return 0;
+    }
+    size_t gcd = 0;
+    bool uniform = true;
+    for (size_t g = 0; g + 1 < groups_.size(); ++g) {
+      gcd = std::gcd(gcd, groups_[g].count_);
+      uniform &= groups_[g].count_ == groups_[0].count_;
+    }
+    size_t target = std::max<size_t>(MM_PAGE_SIZE / sizeof(T), 1);
+    if (uniform && gcd <= target) {
+      return (target / gcd) * gcd;
+    }
+    size_t min_elmts = std::max<size_t>(target / 16, 1);
+    for (size_t parts = (gcd + target - 1) / target;
+         gcd / parts >= min_elmts; ++parts) {
+      if (gcd % parts == 0) {
+        return gcd / parts;
+      }
+    }
+    return 0;
+  }
+
+  /** Index of the group containing an element */
+  size_t FindGroup(size_t off) {
+    auto it = std::upper_bound(groups_.begin(), groups_.end(), off,
+                               [](size_t off, const Group &group) {
+                                 return off < group.off_;
+                               });
+    return (it - groups_.begin()) - 1;
+  }
+
+  /** Decode a group asynchronously, unless it already is */
+  GroupFuture& Launch(size_t group_idx) {
+    auto it = cache_.find(group_idx);
+    if (it != cache_.end()) {
+      return it->second;
+    }
+    while (lru_.size() >= max_groups_) {
+      cache_.erase(lru_.front());
+      lru_.pop_front();
+    }
+    Group group = groups_[group_idx];
+    GroupFuture fut = std::async(std::launch::async, [this, group]() {
+      return ReadGroup(group);
+    }).share();
+    lru_.emplace_back(group_idx);
+    return cache_.emplace(group_idx, fut).first->second;
+  }
+
+  /** Begin decoding the groups of [off, off + count) in parallel */
+  void Prefetch(size_t off, size_t count) override {
+    if (off >= size_) {
+      return;
+    }
+    size_t last = std::min(off + count, size_) - 1;
+    for (size_t g = FindGroup(off); g <= FindGroup(last); ++g) {
+      Launch(g);
+    }
+  }
+
+  /** Decode [off, off + count) directly into a page frame */
+  void Read(size_t off, size_t count, char *buf) override {
+    if (off >= size_) {
+      return;
+    }
+    size_t end = std::min(off + count, size_);
+    Prefetch(off, end - off);
+    for (size_t g = FindGroup(off); g < groups_.size(); ++g) {
+      Group &group = groups_[g];
+      if (group.off_ >= end) {
+        break;
+      }
+      std::shared_ptr<arrow::Table> table = Launch(g).get();
+      size_t first = std::max(off, group.off_);
+      size_t last = std::min(end, group.off_ + group.count_);
+      for (int col = 0; col < kNumCols; ++col) {
+        CopyColumn(*table->column(col), col,
+                   first - group.off_, last - first,
+                   buf + (first - off) * sizeof(T));
+      }
+    }
+  }
+
+  /** Scatter rows [row, row + count) of a column into elements of T */
+  void CopyColumn(const arrow::ChunkedArray &column, int col,
+                  size_t row, size_t count, char *buf) {
+    if (column.type()->id() != arrow::CTypeTraits<ColT>::ArrowType::type_id) {
+      HELOG(kFatal, "Column {} was decoded as {}",
+            col, column.type()->ToString());
+    }
+    T *elmts = reinterpret_cast<T*>(buf);
+    size_t chunk_off = 0;
+    size_t done = 0;
+    for (int c = 0; c < column.num_chunks() && done < count; ++c) {
+      const ArrayT &chunk = static_cast<const ArrayT&>(*column.chunk(c));
+      size_t chunk_len = chunk.length();
+      if (row + done < chunk_off + chunk_len) {
+        const ColT *vals = chunk.raw_values();
+        bool nulls = chunk.null_count() > 0;
+        size_t i = row + done - chunk_off;
+        for (; i < chunk_len && done < count; ++i, ++done) {
+          reinterpret_cast<ColT*>(&elmts[done])[col] =
+              (nulls && chunk.IsNull(i)) ? null_value_ : vals[i];
+        }
+      }
+      chunk_off += chunk_len;
+    }
+  }
+
+  /** Find the files produced for a path prefix (e.g., by mm_kmeans_df) */
+  static std::vector<std::string> Glob(const std::string &prefix) {
+    std::vector<std::string> paths;
+    if (std::filesystem::is_regular_file(prefix)) {
+      paths.emplace_back(prefix);
+      return paths;
+    }
+    std::filesystem::path dir = std::filesystem::path(prefix).parent_path();
+    std::string name = std::filesystem::path(prefix).filename().string();
+    for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+      std::string file = entry.path().filename().string();
+      if (file.rfind(name + "_", 0) == 0) {
+        paths.emplace_back(entry.path().string());
+      }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+};
+
+/** Maps the row groups of Parquet files onto vector pages */
+template<typename T, typename ColT = float>
+class ParquetSource : public ArrowSource<T, ColT> {
+ public:
+  typedef ArrowSource<T, ColT> BaseT;
+  typedef typename BaseT::Group Group;
+  using BaseT::paths_;
+  using BaseT::columns_;
+
+ public:
+  /**
+   * @param paths The parquet files, in vector order
+   * @param columns The columns which make up an element (default: 0..N-1)
+   * @param max_groups Number of row groups to keep decoded
+   * */
+  explicit ParquetSource(const std::vector<std::string> &paths,
+                         const std::vector<int> &columns = {},
+                         size_t max_groups = 4)
+      : BaseT(paths, columns, max_groups) {
+    for (size_t i = 0; i < paths_.size(); ++i) {
+      std::unique_ptr<parquet::arrow::FileReader> reader = Open(paths_[i]);
+      std::shared_ptr<arrow::Schema> schema;
+      arrow::Status status = reader->GetSchema(&schema);
+      if (!status.ok()) {
+        HELOG(kFatal, "Failed to read the schema of {}: {}",
+              paths_[i], status.ToString());
+      }
+      this->CheckSchema(*schema, paths_[i]);
+      std::shared_ptr<parquet::FileMetaData> meta =
+          reader->parquet_reader()->metadata();
+      for (int rg = 0; rg < reader->num_row_groups(); ++rg) {
+        this->AddGroup(i, rg, meta->RowGroup(rg)->num_rows());
+      }
+    }
+  }
+
+  /** Open a parquet file */
+  static std::unique_ptr<parquet::arrow::FileReader> Open(
+      const std::string &path) {
+    std::shared_ptr<arrow::io::ReadableFile> file =
+        arrow::io::ReadableFile::Open(path).ValueOrDie();
+    auto reader = parquet::arrow::OpenFile(
+        file, arrow::default_memory_pool());
+    if (!reader.ok()) {
+      HELOG(kFatal, "Failed to open parquet file {}: {}",
+            path, reader.status().ToString());
+    }
+    return std::move(reader).ValueOrDie();
+  }
+
+  /** Wait for in-flight decodes before the reader goes away */
+  ~ParquetSource() override {
+    this->cache_.clear();
+  }
+
+  /** Decode the projected columns of a row group */
+  std::shared_ptr<arrow::Table> ReadGroup(const Group &group) override {
+    std::unique_ptr<parquet::arrow::FileReader> reader =
+        Open(paths_[group.file_]);
+    std::shared_ptr<arrow::Table> table;
+    arrow::Status status = reader->ReadRowGroup(group.idx_, columns_, &table);
+    if (!status.ok()) {
+      HELOG(kFatal, "Failed to read row group {} of {}: {}",
+            group.idx_, paths_[group.file_], status.ToString());
+    }
+    return table;
+  }
+};
+
+/** Maps the record batches of Arrow IPC files onto vector pages */
+template<typename T, typename ColT = float>
+class ArrowIpcSource : public ArrowSource<T, ColT> {
+ public:
+  typedef ArrowSource<T, ColT> BaseT;
+  typedef typename BaseT::Group Group;
+  using BaseT::paths_;
+  using BaseT::columns_;
+
+ public:
+  /**
+   * @param paths The Arrow IPC files, in vector order
+   * @param columns The columns which make up an element (default: 0..N-1)
+   * @param max_groups Number of record batches to keep decoded
+   * */
+  explicit ArrowIpcSource(const std::vector<std::string> &paths,
+                          const std::vector<int> &columns = {},
+                          size_t max_groups = 4)
+      : BaseT(paths, columns, max_groups) {
+    for (size_t i = 0; i < paths_.size(); ++i) {
+      std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader =
+          Open(paths_[i]);
+      this->CheckSchema(*reader->schema(), paths_[i]);
+      for (int b = 0; b < reader->num_record_batches(); ++b) {
+        std::shared_ptr<arrow::RecordBatch> batch =
+            reader->ReadRecordBatch(b).ValueOrDie();
+        this->AddGroup(i, b, batch->num_rows());
+      }
+    }
+  }
+
+  /** Memory-map an Arrow IPC file */
+  static std::shared_ptr<arrow::ipc::RecordBatchFileReader> Open(
+      const std::string &path) {
+    std::shared_ptr<arrow::io::MemoryMappedFile> file =
+        arrow::io::MemoryMappedFile::Open(
+            path, arrow::io::FileMode::READ).ValueOrDie();
+    return arrow::ipc::RecordBatchFileReader::Open(file).ValueOrDie();
+  }
+
+  /** Wait for in-flight decodes before the reader goes away */
+  ~ArrowIpcSource() override {
+    this->cache_.clear();
+  }
+
+  /** Decode the projected columns of a record batch */
+  std::shared_ptr<arrow::Table> ReadGroup(const Group &group) override {
+    std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader =
+        Open(paths_[group.file_]);
+    std::shared_ptr<arrow::RecordBatch> batch =
+        reader->ReadRecordBatch(group.idx_).ValueOrDie();
+    batch = batch->SelectColumns(columns_).ValueOrDie();
+    return arrow::Table::FromRecordBatches({batch}).ValueOrDie();
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_ARROW_SOURCE_H_
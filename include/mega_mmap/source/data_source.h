@@ -0,0 +1,35 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_DATA_SOURCE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_DATA_SOURCE_H_
+
+#include <string>
+#include "mega_mmap/macros.h"
+
+namespace mm {
+
+/**
+ * A read-only source of vector elements other than a flat binary file.
+ * Pages of a vector bound to a source are decoded directly into the
+ * page frame instead of being read from the Hermes bucket.
+ * */
+class DataSource {
+ public:
+  virtual ~DataSource() = default;
+
+  /** Number of elements in the source */
+  virtual size_t Size() = 0;
+
+  /** Preferred number of elements per page (0 if no preference) */
+  virtual size_t PageElmts() {
+    return 0;
+  }
+
+  /** Decode elements [off, off + count) into buf */
+  virtual void Read(size_t off, size_t count, char *buf) = 0;
+
+  /** Begin decoding elements [off, off + count) in the background */
+  virtual void Prefetch(size_t off, size_t count) {}
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_DATA_SOURCE_H_
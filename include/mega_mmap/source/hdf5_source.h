@@ -0,0 +1,172 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_HDF5_SOURCE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_HDF5_SOURCE_H_
+
+#include <hdf5.h>
+#include <type_traits>
+#include <vector>
+#include "hermes_shm/util/logging.h"
+#include "data_source.h"
+
+namespace mm {
+
+/**
+ * Maps the rows of a 1D or 2D HDF5 dataset (e.g., Gadget2's
+ * /PartType1/Coordinates) onto vector pages. Each page is read with
+ * a hyperslab selection over the first dimension. Each element of T
+ * is built from a projection of the columns of the second dimension,
+ * which are converted to ColT by HDF5.
+ * */
+template<typename T, typename ColT = float>
+class Hdf5Source : public DataSource {
+ public:
+  static constexpr int kNumCols = sizeof(T) / sizeof(ColT);
+  static_assert(sizeof(T) % sizeof(ColT) == 0,
+                "T must be made of ColT fields");
+
+ public:
+  std::string path_;          /**< The HDF5 file */
+  std::string dataset_;       /**< The dataset within the file */
+  std::vector<int> columns_;  /**< Projected column indices */
+  hid_t file_ = -1;           /**< Open file */
+  hid_t dset_ = -1;           /**< Open dataset */
+  hid_t fspace_ = -1;         /**< Dataspace of the dataset */
+  hid_t mtype_ = -1;          /**< In-memory type of a column */
+  int ndims_ = 0;             /**< Number of dataset dimensions */
+  hsize_t dims_[2] = {0, 1};  /**< Rows and columns of the dataset */
+  hsize_t chunk_rows_ = 0;    /**< Rows per chunk (0 if contiguous) */
+  bool contig_cols_ = true;   /**< Projection is a contiguous range */
+
+ public:
+  /**
+   * @param path The HDF5 file
+   * @param dataset The dataset within the file
+   * @param columns The columns which make up an element (default: 0..N-1)
+   * */
+  explicit Hdf5Source(const std::string &path,
+                      const std::string &dataset = "/PartType1/Coordinates",
+                      const std::vector<int> &columns = {})
+      : path_(path), dataset_(dataset), columns_(columns) {
+    if (columns_.empty()) {
+      for (int i = 0; i < kNumCols; ++i) {
+        columns_.emplace_back(i);
+      }
+    }
+    if (columns_.size() != kNumCols) {
+      HELOG(kFatal, "Projected {} columns, but the element has {} fields",
+            columns_.size(), kNumCols);
+    }
+    for (size_t i = 1; i < columns_.size(); ++i) {
+      contig_cols_ &= columns_[i] == columns_[i - 1] + 1;
+    }
+    if constexpr (std::is_same_v<ColT, float>) {
+      mtype_ = H5T_NATIVE_FLOAT;
+    } else if constexpr (std::is_same_v<ColT, double>) {
+      mtype_ = H5T_NATIVE_DOUBLE;
+    } else if constexpr (std::is_same_v<ColT, int>) {
+      mtype_ = H5T_NATIVE_INT;
+    } else {
+      mtype_ = H5T_NATIVE_LLONG;
+    }
+    Open();
+  }
+
+  /** Close the dataset */
+  ~Hdf5Source() override {
+    if (fspace_ >= 0) {
+      H5Sclose(fspace_);
+    }
+    if (dset_ >= 0) {
+      H5Dclose(dset_);
+    }
+    if (file_ >= 0) {
+      H5Fclose(file_);
+    }
+  }
+
+  /** Open the dataset and read its shape and chunking */
+  void Open() {
+    file_ = H5Fopen(path_.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_ < 0) {
+      HELOG(kFatal, "Failed to open HDF5 file {}", path_);
+    }
+    dset_ = H5Dopen(file_, dataset_.c_str(), H5P_DEFAULT);
+    if (dset_ < 0) {
+      HELOG(kFatal, "Failed to open dataset {} in {}", dataset_, path_);
+    }
+    fspace_ = H5Dget_space(dset_);
+    ndims_ = H5Sget_simple_extent_ndims(fspace_);
+    if (ndims_ != 1 && ndims_ != 2) {
+      HELOG(kFatal, "Dataset {} has {} dimensions, expected 1 or 2",
+            dataset_, ndims_);
+    }
+    H5Sget_simple_extent_dims(fspace_, dims_, NULL);
+    for (int col : columns_) {
+      if (col < 0 || (hsize_t)col >= dims_[1]) {
+        HELOG(kFatal, "Column {} is out of range for dataset {}",
+              col, dataset_);
+      }
+    }
+    hid_t dcpl = H5Dget_create_plist(dset_);
+    if (H5Pget_layout(dcpl) == H5D_CHUNKED) {
+      hsize_t chunk[2] = {0, 1};
+      H5Pget_chunk(dcpl, ndims_, chunk);
+      chunk_rows_ = chunk[0];
+    }
+    H5Pclose(dcpl);
+  }
+
+  /** Number of elements in the source */
+  size_t Size() override {
+    return dims_[0];
+  }
+
+  /**
+   * Pages cover a whole number of chunks, so a fault never
+   * decompresses a chunk which another page also reads.
+   * */
+  size_t PageElmts() override {
+    if (chunk_rows_ == 0) {
+      return 0;
+    }
+    size_t chunks_per_page = MM_PAGE_SIZE / (chunk_rows_ * sizeof(T));
+    return std::max<size_t>(chunks_per_page, 1) * chunk_rows_;
+  }
+
+  /** Read rows [off, off + count) into buf with a hyperslab */
+  void Read(size_t off, size_t count, char *buf) override {
+    if (off >= dims_[0]) {
+      return;
+    }
+    count = std::min<size_t>(count, dims_[0] - off);
+    hsize_t mdims[2] = {count, (hsize_t)kNumCols};
+    hid_t mspace = H5Screate_simple(ndims_, mdims, NULL);
+    if (contig_cols_) {
+      hsize_t start[2] = {off, (hsize_t)columns_[0]};
+      hsize_t cnt[2] = {count, (hsize_t)kNumCols};
+      H5Sselect_hyperslab(fspace_, H5S_SELECT_SET, start, NULL, cnt, NULL);
+      _Read(mspace, buf);
+    } else {
+      // Each projected column lands in its own field of T
+      for (int i = 0; i < kNumCols; ++i) {
+        hsize_t fstart[2] = {off, (hsize_t)columns_[i]};
+        hsize_t mstart[2] = {0, (hsize_t)i};
+        hsize_t cnt[2] = {count, 1};
+        H5Sselect_hyperslab(fspace_, H5S_SELECT_SET, fstart, NULL, cnt, NULL);
+        H5Sselect_hyperslab(mspace, H5S_SELECT_SET, mstart, NULL, cnt, NULL);
+        _Read(mspace, buf);
+      }
+    }
+    H5Sclose(mspace);
+  }
+
+  /** Read the current selection */
+  void _Read(hid_t mspace, char *buf) {
+    if (H5Dread(dset_, mtype_, mspace, fspace_, H5P_DEFAULT, buf) < 0) {
+      HELOG(kFatal, "Failed to read dataset {} in {}", dataset_, path_);
+    }
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_SOURCE_HDF5_SOURCE_H_
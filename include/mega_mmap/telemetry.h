@@ -0,0 +1,361 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_TELEMETRY_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_TELEMETRY_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <mpi.h>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+/**
+ * Trace points for hot paths (e.g., ProcessLog, eviction). They compile
+ * to nothing unless MM_ENABLE_TRACE is defined (-DMEGAMMAP_ENABLE_TRACE=ON).
+ * */
+#ifdef MM_ENABLE_TRACE
+#define MM_TRACE(...) HILOG(kDebug, __VA_ARGS__)
+#else
+#define MM_TRACE(...)
+#endif
+
+namespace mm {
+
+/** Where the bytes of a faulted page came from */
+enum class PageSource {
+  kBackend,     /**< The Hermes bucket (whichever tier holds the blob) */
+  kNodeCache,   /**< A frame faulted by another rank on the node */
+  kRma,         /**< The memory of the rank which owns the page */
+  kDataSource,  /**< Decoded from a DataSource */
+  kCount
+};
+
+/** Counters of the page cache of one vector on one rank */
+struct VectorStats {
+  static constexpr size_t kNumSources = (size_t)PageSource::kCount;
+  static constexpr size_t kNumFields = 8 + kNumSources;
+
+  u64 faults_ = 0;         /**< Pages faulted in */
+  u64 hits_ = 0;           /**< Accesses to resident pages */
+  u64 prefetch_hits_ = 0;  /**< First accesses to asynchronously faulted pages */
+  u64 evictions_ = 0;      /**< Pages dropped from memory */
+  u64 flushes_ = 0;        /**< Dirty pages written to the backend */
+  u64 bytes_in_[kNumSources] = {};  /**< Bytes faulted in per source */
+  u64 bytes_out_ = 0;      /**< Bytes flushed or appended to the backend */
+  double stall_secs_ = 0;  /**< Time accesses waited for pages */
+  u64 peak_memory_ = 0;    /**< Peak of cur_memory_ */
+
+  /** Record bytes faulted in from a source */
+  void In(PageSource src, size_t bytes) {
+    bytes_in_[(size_t)src] += bytes;
+  }
+
+  /** Record the current memory use of the vector */
+  void Peak(size_t cur_memory) {
+    peak_memory_ = std::max<u64>(peak_memory_, cur_memory);
+  }
+
+  /** The name of the i'th counter */
+  static const char* FieldName(size_t i) {
+    static const char *names[kNumFields] = {
+        "faults", "hits", "prefetch_hits", "evictions", "flushes",
+        "bytes_in_backend", "bytes_in_node_cache", "bytes_in_rma",
+        "bytes_in_source", "bytes_out", "stall_secs", "peak_memory"};
+    return names[i];
+  }
+
+  /** Whether the i'th counter combines by max instead of sum */
+  static bool IsPeak(size_t i) {
+    return i == kNumFields - 1;
+  }
+
+  /** Store every counter in vals, in FieldName order */
+  void Pack(double *vals) const {
+    size_t i = 0;
+    vals[i++] = (double)faults_;
+    vals[i++] = (double)hits_;
+    vals[i++] = (double)prefetch_hits_;
+    vals[i++] = (double)evictions_;
+    vals[i++] = (double)flushes_;
+    for (size_t src = 0; src < kNumSources; ++src) {
+      vals[i++] = (double)bytes_in_[src];
+    }
+    vals[i++] = (double)bytes_out_;
+    vals[i++] = stall_secs_;
+    vals[i++] = (double)peak_memory_;
+  }
+};
+
+/** Adds the time of a scope to the stall time of a vector */
+class StallTimer {
+ public:
+  VectorStats &stats_;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  explicit StallTimer(VectorStats &stats)
+      : stats_(stats), start_(std::chrono::steady_clock::now()) {}
+
+  ~StallTimer() {
+    std::chrono::duration<double> secs =
+        std::chrono::steady_clock::now() - start_;
+    stats_.stall_secs_ += secs.count();
+  }
+};
+
+/** A counter of a vector aggregated across ranks */
+struct StatSummary {
+  double min_ = 0;
+  double max_ = 0;
+  double mean_ = 0;
+};
+
+/** The counters of a vector aggregated across the ranks which used it */
+struct VectorSummary {
+  std::string name_;
+  int ranks_ = 0;
+  StatSummary stats_[VectorStats::kNumFields];
+};
+
+/**
+ * The per-process registry of vector counters. Vectors register their
+ * counters at Init and retire them at Destroy (or destruction), so the
+ * counters of every vector the process used can be aggregated across
+ * ranks. If MM_TELEMETRY is set to a path prefix, the aggregate is
+ * written to {prefix}.json and {prefix}.csv at MPI_Finalize (every
+ * rank must have initialized a vector).
+ * */
+class Telemetry {
+ public:
+  std::mutex lock_;
+  std::unordered_map<const VectorStats*, std::string> live_;
+  std::vector<std::pair<std::string, VectorStats>> retired_;
+  bool hooked_ = false;
+
+ public:
+  /** Get the per-process registry */
+  static Telemetry* GetInstance() {
+    static Telemetry telemetry;
+    return &telemetry;
+  }
+
+  /** Track the counters of a live vector */
+  void Register(const std::string &name, const VectorStats *stats) {
+    std::lock_guard<std::mutex> guard(lock_);
+    live_[stats] = name;
+    if (!hooked_) {
+      hooked_ = true;
+      _HookFinalize();
+    }
+  }
+
+  /** Track the counters of a moved vector at their new address */
+  void Move(const VectorStats *from, const VectorStats *to) {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto it = live_.find(from);
+    if (it == live_.end()) {
+      return;
+    }
+    std::string name = std::move(it->second);
+    live_.erase(it);
+    live_[to] = std::move(name);
+  }
+
+  /** Keep the final counters of a vector (no-op if not registered) */
+  void Retire(const VectorStats *stats) {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto it = live_.find(stats);
+    if (it == live_.end()) {
+      return;
+    }
+    retired_.emplace_back(it->second, *stats);
+    live_.erase(it);
+  }
+
+  /** The counters of this rank per vector name (live and retired) */
+  std::map<std::string, std::vector<double>> Local() {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::map<std::string, std::vector<double>> local;
+    auto merge = [&local](const std::string &name,
+                          const VectorStats &stats) {
+      double vals[VectorStats::kNumFields];
+      stats.Pack(vals);
+      auto it = local.find(name);
+      if (it == local.end()) {
+        local.emplace(name, std::vector<double>(
+            vals, vals + VectorStats::kNumFields));
+        return;
+      }
+      for (size_t i = 0; i < VectorStats::kNumFields; ++i) {
+        it->second[i] = VectorStats::IsPeak(i) ?
+            std::max(it->second[i], vals[i]) : it->second[i] + vals[i];
+      }
+    };
+    for (auto &[name, stats] : retired_) {
+      merge(name, stats);
+    }
+    for (auto &[stats, name] : live_) {
+      merge(name, *stats);
+    }
+    return local;
+  }
+
+  /**
+   * Aggregate the counters of each vector across the ranks of comm
+   * (collective). The summaries are only returned on rank 0.
+   * */
+  std::vector<VectorSummary> Aggregate(MPI_Comm comm) {
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    // Serialize (name length, name, counters) per vector
+    std::string buf;
+    for (auto &[name, vals] : Local()) {
+      u64 len = name.size();
+      buf.append((char*)&len, sizeof(len));
+      buf.append(name);
+      buf.append((char*)vals.data(), vals.size() * sizeof(double));
+    }
+    int size = (int)buf.size();
+    std::vector<int> sizes(nprocs), offs(nprocs + 1, 0);
+    MPI_Gather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm);
+    for (int i = 0; i < nprocs; ++i) {
+      offs[i + 1] = offs[i] + sizes[i];
+    }
+    std::string all(rank == 0 ? offs[nprocs] : 0, 0);
+    MPI_Gatherv(buf.data(), size, MPI_CHAR, all.data(), sizes.data(),
+                offs.data(), MPI_CHAR, 0, comm);
+    if (rank != 0) {
+      return {};
+    }
+    // Combine the ranks which used each vector
+    std::map<std::string, VectorSummary> sums;
+    size_t off = 0;
+    while (off < all.size()) {
+      u64 len;
+      memcpy(&len, all.data() + off, sizeof(len));
+      off += sizeof(len);
+      std::string name = all.substr(off, len);
+      off += len;
+      double vals[VectorStats::kNumFields];
+      memcpy(vals, all.data() + off, sizeof(vals));
+      off += sizeof(vals);
+      VectorSummary &sum = sums[name];
+      sum.name_ = name;
+      for (size_t i = 0; i < VectorStats::kNumFields; ++i) {
+        StatSummary &stat = sum.stats_[i];
+        stat.min_ = sum.ranks_ ? std::min(stat.min_, vals[i]) : vals[i];
+        stat.max_ = sum.ranks_ ? std::max(stat.max_, vals[i]) : vals[i];
+        stat.mean_ += vals[i];
+      }
+      ++sum.ranks_;
+    }
+    std::vector<VectorSummary> summaries;
+    for (auto &[name, sum] : sums) {
+      for (StatSummary &stat : sum.stats_) {
+        stat.mean_ /= sum.ranks_;
+      }
+      summaries.emplace_back(sum);
+    }
+    return summaries;
+  }
+
+  /**
+   * Write the aggregate counters to {prefix}.json and {prefix}.csv
+   * (collective over comm, written by rank 0)
+   * */
+  void Dump(MPI_Comm comm, const std::string &prefix) {
+    std::vector<VectorSummary> summaries = Aggregate(comm);
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank != 0) {
+      return;
+    }
+    WriteJson(prefix + ".json", summaries);
+    WriteCsv(prefix + ".csv", summaries);
+    HILOG(kInfo, "Wrote telemetry of {} vectors to {}",
+          summaries.size(), prefix);
+  }
+
+  /** Write summaries as a JSON array of vectors */
+  static void WriteJson(const std::string &path,
+                        const std::vector<VectorSummary> &summaries) {
+    std::ofstream out(path);
+    out << "[\n";
+    for (size_t v = 0; v < summaries.size(); ++v) {
+      const VectorSummary &sum = summaries[v];
+      out << "  {\"vector\": \"" << _Escape(sum.name_) << "\", "
+          << "\"ranks\": " << sum.ranks_;
+      for (size_t i = 0; i < VectorStats::kNumFields; ++i) {
+        const StatSummary &stat = sum.stats_[i];
+        out << ",\n   \"" << VectorStats::FieldName(i) << "\": {"
+            << "\"min\": " << stat.min_ << ", "
+            << "\"max\": " << stat.max_ << ", "
+            << "\"mean\": " << stat.mean_ << "}";
+      }
+      out << "}" << (v + 1 < summaries.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+  }
+
+  /** Write summaries with one row per vector and counter */
+  static void WriteCsv(const std::string &path,
+                       const std::vector<VectorSummary> &summaries) {
+    std::ofstream out(path);
+    out << "vector,ranks,counter,min,max,mean\n";
+    for (const VectorSummary &sum : summaries) {
+      for (size_t i = 0; i < VectorStats::kNumFields; ++i) {
+        const StatSummary &stat = sum.stats_[i];
+        out << sum.name_ << "," << sum.ranks_ << ","
+            << VectorStats::FieldName(i) << "," << stat.min_ << ","
+            << stat.max_ << "," << stat.mean_ << "\n";
+      }
+    }
+  }
+
+  /** Escape a string for JSON */
+  static std::string _Escape(const std::string &str) {
+    std::string esc;
+    for (char c : str) {
+      if (c == '"' || c == '\\') {
+        esc += '\\';
+      }
+      esc += c;
+    }
+    return esc;
+  }
+
+  /**
+   * Dump at MPI_Finalize if MM_TELEMETRY is set. MPI_Finalize deletes
+   * the attributes of MPI_COMM_SELF first, while MPI is still usable.
+   * */
+  void _HookFinalize() {
+    if (std::getenv("MM_TELEMETRY") == nullptr) {
+      return;
+    }
+    int keyval;
+    MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, _OnFinalize,
+                           &keyval, nullptr);
+    MPI_Comm_set_attr(MPI_COMM_SELF, keyval, nullptr);
+  }
+
+  /** Attribute delete callback which dumps the counters */
+  static int _OnFinalize(MPI_Comm comm, int keyval,
+                         void *attr, void *extra) {
+    GetInstance()->Dump(MPI_COMM_WORLD, std::getenv("MM_TELEMETRY"));
+    return MPI_SUCCESS;
+  }
+};
+
+}  // namespace mm
+
+#define MM_TELEMETRY mm::Telemetry::GetInstance()
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_TELEMETRY_H_
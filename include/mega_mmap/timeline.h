@@ -0,0 +1,170 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_TIMELINE_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_TIMELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <mpi.h>
+#include "hermes_shm/util/logging.h"
+#include "macros.h"
+
+namespace mm {
+
+/** A timed span of a thread */
+struct TimelineSpan {
+  const char *name_;  /**< What ran (a string literal) */
+  const char *cat_;   /**< The category (e.g., io, sync, tx, compute) */
+  u64 start_ns_;      /**< Start, in nanoseconds since the timeline began */
+  u64 dur_ns_;        /**< Duration in nanoseconds */
+  u64 arg_;           /**< An argument (e.g., page index or count) */
+  u32 tid_;           /**< The thread which ran the span */
+};
+
+/**
+ * A timeline of spans (faults, flushes, barriers, transactions) of
+ * every thread in the process, in the Chrome trace event format
+ * (chrome://tracing, Perfetto). Enabled by setting MM_TIMELINE to a
+ * path prefix; each rank writes {prefix}.{rank}.json at exit.
+ * Spans are stored in a lock-free ring: threads claim slots with an
+ * atomic increment, and the oldest spans are overwritten once full.
+ * */
+class Timeline {
+ public:
+  static constexpr size_t kRingSize = 1 << 20;
+
+ public:
+  std::string prefix_;
+  std::unique_ptr<TimelineSpan[]> ring_;
+  std::atomic<u64> head_{0};       /**< Spans recorded so far */
+  std::atomic<u32> num_threads_{0};
+  std::atomic<int> rank_{-1};
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  Timeline() {
+    const char *prefix = std::getenv("MM_TIMELINE");
+    if (prefix) {
+      prefix_ = prefix;
+      ring_ = std::make_unique<TimelineSpan[]>(kRingSize);
+    }
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  ~Timeline() {
+    Write();
+  }
+
+  /** Get the per-process timeline */
+  static Timeline* GetInstance() {
+    static Timeline timeline;
+    return &timeline;
+  }
+
+  /** Whether MM_TIMELINE is set */
+  bool IsEnabled() const {
+    return ring_ != nullptr;
+  }
+
+  /** Nanoseconds since the timeline began */
+  u64 Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+  }
+
+  /** The id of the calling thread */
+  u32 ThreadId() {
+    thread_local u32 tid = num_threads_.fetch_add(1);
+    return tid;
+  }
+
+  /** Record a span which began at start_ns and ends now */
+  void Record(const char *name, const char *cat, u64 start_ns, u64 arg) {
+    if (rank_.load(std::memory_order_relaxed) < 0) {
+      _FindRank();
+    }
+    u64 end_ns = Now();
+    u64 slot = head_.fetch_add(1, std::memory_order_relaxed);
+    ring_[slot % kRingSize] = TimelineSpan{
+        name, cat, start_ns, end_ns - start_ns, arg, ThreadId()};
+  }
+
+  /** Write the spans in the ring as Chrome trace events */
+  void Write() {
+    int rank = rank_.load();
+    if (!IsEnabled() || rank < 0) {
+      return;
+    }
+    std::string path =
+        hshm::Formatter::format("{}.{}.json", prefix_, rank);
+    std::ofstream out(path);
+    u64 head = head_.load();
+    u64 first = head > kRingSize ? head - kRingSize : 0;
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+        << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << rank
+        << ", \"args\": {\"name\": \"rank " << rank << "\"}}";
+    for (u64 i = first; i < head; ++i) {
+      const TimelineSpan &span = ring_[i % kRingSize];
+      out << ",\n{\"name\": \"" << span.name_ << "\", "
+          << "\"cat\": \"" << span.cat_ << "\", \"ph\": \"X\", "
+          << "\"ts\": " << span.start_ns_ / 1000.0 << ", "
+          << "\"dur\": " << span.dur_ns_ / 1000.0 << ", "
+          << "\"pid\": " << rank << ", \"tid\": " << span.tid_ << ", "
+          << "\"args\": {\"arg\": " << span.arg_ << "}}";
+    }
+    out << "\n]}\n";
+    if (first) {
+      HILOG(kInfo, "{}: The timeline kept the last {} of {} spans",
+            rank, kRingSize, head);
+    }
+  }
+
+  /** Find the rank which names the output (once MPI is initialized) */
+  void _FindRank() {
+    int init = 0;
+    MPI_Initialized(&init);
+    if (init) {
+      int rank;
+      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+      rank_.store(rank);
+    }
+  }
+};
+
+/** Records the span of a scope in the timeline */
+class TimelineScope {
+ public:
+  const char *name_;
+  const char *cat_;
+  u64 arg_;
+  u64 start_ns_;
+  bool enabled_;
+
+ public:
+  TimelineScope(const char *name, const char *cat, u64 arg)
+      : name_(name), cat_(cat), arg_(arg) {
+    enabled_ = Timeline::GetInstance()->IsEnabled();
+    if (enabled_) {
+      start_ns_ = Timeline::GetInstance()->Now();
+    }
+  }
+
+  ~TimelineScope() {
+    if (enabled_) {
+      Timeline::GetInstance()->Record(name_, cat_, start_ns_, arg_);
+    }
+  }
+};
+
+}  // namespace mm
+
+#define MM_TIMELINE mm::Timeline::GetInstance()
+#define MM_SPAN_CAT(A, B) A##B
+#define MM_SPAN_NAME(LINE) MM_SPAN_CAT(mm_span_, LINE)
+/** Record the rest of the enclosing scope as a span */
+#define MM_SPAN(NAME, CAT, ARG) \
+  mm::TimelineScope MM_SPAN_NAME(__LINE__)(NAME, CAT, (u64)(ARG))
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_TIMELINE_H_
@@ -41,10 +41,8 @@ class RandIterTx : public Tx {
   virtual ~RandIterTx() = default;
 
   void _ProcessLog(bool end) override {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    HILOG(kInfo, "{}: Processing log: {} {}",
-          rank, head_, tail_);
+    MM_TRACE("{}: Processing log: {} {}",
+             vec_->rank_, head_, tail_);
     // Get number of pages iterated over
     size_t num_pages = num_pages_;
     if (num_pages <= 1 && !end) {
@@ -55,8 +53,8 @@ class RandIterTx : public Tx {
     }
 
     // Evict processed pages
-    HILOG(kInfo, "{}: Evicting {} pages",
-          rank, num_pages)
+    MM_TRACE("{}: Evicting {} pages",
+             vec_->rank_, num_pages);
     for (size_t i = 0; i < num_pages; ++i) {
       size_t page_idx = log_gen_.GetSize() / vec_->elmts_per_page_;
       vec_->Rescore(page_idx,
@@ -72,8 +70,8 @@ class RandIterTx : public Tx {
     }
     prefetch_gen_ = log_gen_;
     size_t count = NumPrefetchPages(size_);
-    HILOG(kInfo, "{}: Prefetching {} pages",
-          rank, count)
+    MM_TRACE("{}: Prefetching {} pages",
+             vec_->rank_, count);
     for (size_t i = 0; i < count; ++i) {
       size_t page_idx = prefetch_gen_.GetSize() / vec_->elmts_per_page_;
       vec_->Rescore(page_idx,
@@ -34,9 +34,7 @@ class SeqIterTx : public Tx {
 
   /** Process the accesses that have occurred */
   void _ProcessLog(bool end) override {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    HILOG(kInfo, "{}: Processing log: {} {}", rank, head_, tail_);
+    MM_TRACE("{}: Processing log: {} {}", vec_->rank_, head_, tail_);
     size_t first_page = (head_ + off_) / vec_->elmts_per_page_;
     size_t last_page = (tail_ + off_) / vec_->elmts_per_page_;
     if (first_page == last_page) {
@@ -46,16 +44,16 @@ class SeqIterTx : public Tx {
     // Evict pages we no longer need
     size_t first_mod = (head_ + off_) % vec_->elmts_per_page_;
     size_t first_rem = vec_->elmts_per_page_ - first_mod;
-    HILOG(kInfo, "{}: Evicting pages: {} (off={} size={}) to {}",
-          rank, first_page, first_mod, first_rem, last_page)
+    MM_TRACE("{}: Evicting pages: {} (off={} size={}) to {}",
+             vec_->rank_, first_page, first_mod, first_rem, last_page);
     vec_->Rescore(first_page, first_mod, first_rem,
                   0, flags_);
     for (size_t i = first_page + 1; i < last_page; ++i) {
       vec_->Rescore(i, 0, vec_->elmts_per_page_,
                     0, flags_);
     }
-    HILOG(kInfo, "{}: Finished evicting pages: {} (off={} size={}) to {}",
-          rank, first_page, first_mod, first_rem, last_page)
+    MM_TRACE("{}: Finished evicting pages: {} (off={} size={}) to {}",
+             vec_->rank_, first_page, first_mod, first_rem, last_page);
 
     // Prefetch future pages
     if (vec_->window_size_ >= vec_->cur_memory_ || end) {
@@ -65,8 +63,8 @@ class SeqIterTx : public Tx {
     if (last_prefetch_ <= last_page) {
       last_prefetch_ = last_page + 1;
     }
-    HILOG(kInfo, "{}: Prefetching pages: {} to {}",
-          rank, last_prefetch_, last_prefetch_ + count - 1)
+    MM_TRACE("{}: Prefetching pages: {} to {}",
+             vec_->rank_, last_prefetch_, last_prefetch_ + count - 1);
     for (size_t i = 0; i < count; ++i) {
       vec_->Rescore(last_prefetch_++, 0,
                     vec_->elmts_per_page_,
@@ -8,6 +8,8 @@
 #include "hermes_shm/data_structures/data_structure.h"
 #include "mega_mmap/macros.h"
 #include "mega_mmap/vector.h"
+#include "mega_mmap/telemetry.h"
+#include "mega_mmap/timeline.h"
 
 namespace mm {
 
@@ -28,6 +30,7 @@ class Tx {
   virtual void _ProcessLog(bool end) = 0;
 
   void ProcessLog(bool end) {
+    MM_SPAN("ProcessLog", "tx", tail_);
     _ProcessLog(end);
     head_ = tail_;
   }
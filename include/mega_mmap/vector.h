@@ -5,6 +5,8 @@
 #ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_H_
 #define MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_H_
 
+#include <mpi.h>
+
 namespace mm {
 
 /**
@@ -26,6 +28,9 @@ class Vector {
   PGAS pgas_;                  /** PGAS mapping of vector elements */
   Bounds bounds_;              /** Bounds of the vector */
   bitfield32_t flags_;         /** Access flags for this vector */
+  MPI_Comm comm_ = MPI_COMM_WORLD;  /** Ranks sharing the vector */
+  int rank_ = 0;               /** Rank in comm_ */
+  int nprocs_ = 1;             /** Number of ranks in comm_ */
 
  public:
   virtual void Rescore(size_t page_idx, size_t mod_start, size_t mod_count,
@@ -0,0 +1,349 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_COLUMNAR_MPI_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_COLUMNAR_MPI_H_
+
+#include "vector_mega_mpi.h"
+
+namespace mm {
+
+/** Select every column of a columnar vector */
+#define MM_ALL_COLS (~(u64)0)
+
+/** Forward declaration */
+template<typename T, typename ColT>
+class VectorColumnarMpi;
+
+/** Proxy for a single row of a columnar vector */
+template<typename T, typename ColT>
+class ColumnarRow {
+ public:
+  static constexpr int kNumCols = sizeof(T) / sizeof(ColT);
+
+ public:
+  VectorColumnarMpi<T, ColT> *vec_;
+  size_t idx_;
+  u64 bound_ = 0;              /**< Fields already fetched by a transaction */
+  ColT *fields_[kNumCols];     /**< The fetched fields */
+
+ public:
+  ColumnarRow(VectorColumnarMpi<T, ColT> *vec, size_t idx)
+      : vec_(vec), idx_(idx) {}
+
+  /** Use a field fetched by a transaction instead of indexing again */
+  void Bind(int col, ColT *field) {
+    bound_ |= ((u64)1) << col;
+    fields_[col] = field;
+  }
+
+  /** Access a single field of the row */
+  ColT& operator[](int col) {
+    if (bound_ & (((u64)1) << col)) {
+      return *fields_[col];
+    }
+    return vec_->cols_[col][idx_];
+  }
+
+  /** Gather a set of fields into a row (the others are zero) */
+  T Get(u64 cols = MM_ALL_COLS) {
+    T row{};
+    ColT *fields = reinterpret_cast<ColT*>(&row);
+    for (int i = 0; i < kNumCols; ++i) {
+      if (cols & (((u64)1) << i)) {
+        fields[i] = (*this)[i];
+      }
+    }
+    return row;
+  }
+
+  /** Gather all fields into a row */
+  operator T() {
+    return Get();
+  }
+
+  /** Scatter a row into its columns */
+  ColumnarRow& operator=(const T &row) {
+    const ColT *fields = reinterpret_cast<const ColT*>(&row);
+    for (int i = 0; i < kNumCols; ++i) {
+      (*this)[i] = fields[i];
+    }
+    return *this;
+  }
+};
+
+/**
+ * A columnar (SoA) vector of multi-field elements. Each field of T is
+ * stored in its own DSM vector, so a transaction only pages in the
+ * columns it declares. T must be a packed struct of ColT fields
+ * (e.g., Row, RowND<N>, ClassRow with ColT=float).
+ * */
+template<typename T, typename ColT = float>
+class VectorColumnarMpi {
+ public:
+  typedef VectorMegaMpi<ColT> ColumnT;
+  static constexpr int kNumCols = sizeof(T) / sizeof(ColT);
+  static_assert(sizeof(T) % sizeof(ColT) == 0,
+                "T must be made of ColT fields");
+  static_assert(kNumCols <= 64,
+                "At most 64 columns are supported");
+
+ public:
+  std::vector<ColumnT> cols_;  /**< One vector per field */
+  std::string path_;           /**< The path being mapped into memory */
+  size_t window_size_ = 0;     /**< Memory bound across all columns */
+  u64 tx_cols_ = 0;            /**< Columns used by the current transaction */
+
+ public:
+  VectorColumnarMpi() = default;
+  ~VectorColumnarMpi() = default;
+
+  /** Bitmask of a single column */
+  static u64 ColMask(int col) {
+    return ((u64)1) << col;
+  }
+
+  /** Bitmask of a set of columns */
+  static u64 ColMask(std::initializer_list<int> cols) {
+    u64 mask = 0;
+    for (int col : cols) {
+      mask |= ColMask(col);
+    }
+    return mask;
+  }
+
+  /** The path of the bucket backing a column */
+  static std::string ColPath(const std::string &path, int col) {
+    return hshm::Formatter::format("{}_col{}", path, col);
+  }
+
+  /** Explicit initializer */
+  void Init(const std::string &path, u32 flags) {
+    size_t data_size = 0;
+    if (stdfs::exists(ColPath(path, 0))) {
+      data_size = stdfs::file_size(ColPath(path, 0));
+    }
+    Init(path, data_size / sizeof(ColT), flags);
+  }
+
+  /** Explicit initializer */
+  void Init(const std::string &path, size_t count, u32 flags) {
+    if (cols_.size()) {
+      return;
+    }
+    path_ = path;
+    cols_.resize(kNumCols);
+    for (int i = 0; i < kNumCols; ++i) {
+      cols_[i].Init(ColPath(path, i), count, flags);
+    }
+  }
+
+  /** Ensure this DSM doesn't exceed DRAM capacity */
+  void BoundMemory(size_t window_size) {
+    window_size_ = window_size;
+    for (ColumnT &col : cols_) {
+      col.BoundMemory(window_size / kNumCols);
+    }
+  }
+
+  /** Evenly split DSM among processes */
+  void EvenPgas(int rank, int nprocs, size_t max_count,
+                size_t count_per_page = 0) {
+    for (ColumnT &col : cols_) {
+      col.EvenPgas(rank, nprocs, max_count, count_per_page);
+    }
+  }
+
+  /** Allocate the DSM */
+  void Allocate() {
+    for (ColumnT &col : cols_) {
+      col.Allocate();
+    }
+  }
+
+  /**
+   * Give the window to the columns of a transaction. Columns which
+   * are not touched by the transaction are never paged in.
+   * */
+  void _BeginCols(u64 cols) {
+    u64 all_cols = MM_ALL_COLS >> (64 - kNumCols);
+    tx_cols_ = cols & all_cols;
+    size_t ncols = __builtin_popcountll(tx_cols_);
+    if (window_size_ && ncols) {
+      for (int i = 0; i < kNumCols; ++i) {
+        if (tx_cols_ & ColMask(i)) {
+          cols_[i].BoundMemory(window_size_ / ncols);
+        }
+      }
+    }
+  }
+
+  /** Create a sequential transaction over a set of columns */
+  void SeqTxBegin(size_t off, size_t size, uint32_t flags,
+                  u64 cols = MM_ALL_COLS) {
+    _BeginCols(cols);
+    for (int i = 0; i < kNumCols; ++i) {
+      if (tx_cols_ & ColMask(i)) {
+        cols_[i].SeqTxBegin(off, size, flags);
+      }
+    }
+  }
+
+  /** Create a PGAS transaction over a set of columns */
+  void PgasTxBegin(size_t off, size_t size, uint32_t flags,
+                   u64 cols = MM_ALL_COLS) {
+    _BeginCols(cols);
+    for (int i = 0; i < kNumCols; ++i) {
+      if (tx_cols_ & ColMask(i)) {
+        cols_[i].PgasTxBegin(off, size, flags);
+      }
+    }
+  }
+
+  /**
+   * Create a random transaction over a set of columns. Every column
+   * uses the same seed and page size, so they visit the same pages.
+   * */
+  void RandTxBegin(size_t seed, size_t rand_left, size_t rand_size,
+                   size_t size, uint32_t flags,
+                   u64 cols = MM_ALL_COLS) {
+    _BeginCols(cols);
+    for (int i = 0; i < kNumCols; ++i) {
+      if (tx_cols_ & ColMask(i)) {
+        cols_[i].RandTxBegin(seed, rand_left, rand_size, size, flags);
+      }
+    }
+  }
+
+  /** Get the current point in iterator (the same in every column) */
+  template<typename TxT>
+  size_t TxGetIdx() {
+    size_t idx = 0;
+    bool first = true;
+    for (int i = 0; i < kNumCols; ++i) {
+      if (tx_cols_ & ColMask(i)) {
+        size_t col_idx = cols_[i].template TxGetIdx<TxT>();
+        if (first) {
+          idx = col_idx;
+          first = false;
+        } else if (col_idx != idx) {
+          HELOG(kFatal, "Column {} of {} is at row {}, but column 0 at {}",
+                i, path_, col_idx, idx);
+        }
+      }
+    }
+    return idx;
+  }
+
+  /**
+   * Get the row at the current iterator point. Every column of the
+   * transaction is accessed exactly once, so their iterators stay in
+   * step no matter which fields the caller reads.
+   * */
+  template<typename TxT>
+  ColumnarRow<T, ColT> TxGet() {
+    ColumnarRow<T, ColT> row(this, TxGetIdx<TxT>());
+    for (int i = 0; i < kNumCols; ++i) {
+      if (tx_cols_ & ColMask(i)) {
+        row.Bind(i, &cols_[i].template TxGet<TxT>());
+      }
+    }
+    return row;
+  }
+
+  /** End a transaction */
+  void TxEnd() {
+    for (int i = 0; i < kNumCols; ++i) {
+      if (tx_cols_ & ColMask(i)) {
+        cols_[i].TxEnd();
+      }
+    }
+    tx_cols_ = 0;
+  }
+
+  /** Access a single column */
+  ColumnT& Col(int col) {
+    return cols_[col];
+  }
+
+  /** Row proxy */
+  ColumnarRow<T, ColT> operator[](size_t idx) {
+    return ColumnarRow<T, ColT>(this, idx);
+  }
+
+  /**
+   * Scan a column of the current transaction one contiguous span at a
+   * time. fn(const ColT *data, size_t count, size_t idx) is called for
+   * each part of a page in [off, off + size), so the loop body can be
+   * vectorized by the compiler.
+   * */
+  template<typename F>
+  void ScanCol(int col, size_t off, size_t size, F &&fn) {
+    ColumnT &vec = cols_[col];
+    size_t end = off + size;
+    while (off < end) {
+      size_t count = end - off;
+      const ColT *data = vec.ReadSpan(off, count);
+      fn(data, count, off);
+      off += count;
+    }
+  }
+
+  /**
+   * Scatter the local partition of a row-oriented vector into the
+   * columns of this vector.
+   * */
+  void Import(VectorMegaMpi<T> &rows) {
+    size_t off = rows.local_off();
+    size_t size = rows.local_size();
+    rows.SeqTxBegin(off, size, MM_READ_ONLY);
+    SeqTxBegin(off, size, MM_WRITE_ONLY);
+    for (size_t i = off; i < off + size; ++i) {
+      (*this)[i] = rows[i];
+    }
+    TxEnd();
+    rows.TxEnd();
+  }
+
+  /** Lock a region */
+  void Barrier(u32 flags, MPI_Comm comm) {
+    for (ColumnT &col : cols_) {
+      col.Barrier(flags, comm);
+    }
+  }
+
+  /** Hint access pattern */
+  void Hint(u32 flags) {
+    for (ColumnT &col : cols_) {
+      col.Hint(flags);
+    }
+  }
+
+  /** Size */
+  size_t size() const {
+    return cols_[0].size();
+  }
+
+  /** Size of PGAS region */
+  size_t local_size() const {
+    return cols_[0].local_size();
+  }
+
+  /** Offset of local PGAS region */
+  size_t local_off() const {
+    return cols_[0].local_off();
+  }
+
+  /** Index of last element + 1 */
+  size_t local_last() const {
+    return cols_[0].local_last();
+  }
+
+  /** Destroy region */
+  void Destroy() {
+    for (ColumnT &col : cols_) {
+      col.Destroy();
+    }
+  }
+};
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_COLUMNAR_MPI_H_
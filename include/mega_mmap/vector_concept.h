@@ -0,0 +1,79 @@
+#ifndef MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_CONCEPT_H_
+#define MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_CONCEPT_H_
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <mpi.h>
+#include "macros.h"
+
+namespace mm {
+
+/**
+ * Define a trait NAME<VecT> which is true if EXPR compiles, where
+ * MM_VEC_REF is an lvalue of VecT
+ * */
+#define MM_VECTOR_REQUIRES(NAME, EXPR) \
+  template<typename VecT, typename = void> \
+  struct NAME : std::false_type {}; \
+  template<typename VecT> \
+  struct NAME<VecT, std::void_t<decltype(EXPR)>> : std::true_type {};
+#define MM_VEC_REF std::declval<VecT&>()
+
+MM_VECTOR_REQUIRES(HasInit,
+    MM_VEC_REF.Init(std::declval<const std::string&>(), size_t(), u32()))
+MM_VECTOR_REQUIRES(HasCommInit,
+    MM_VEC_REF.InitComm(MPI_Comm(), std::declval<const std::string&>(),
+                    size_t(), u32()))
+MM_VECTOR_REQUIRES(HasBoundMemory, MM_VEC_REF.BoundMemory(size_t()))
+MM_VECTOR_REQUIRES(HasEvenPgas, MM_VEC_REF.EvenPgas(int(), int(), size_t()))
+MM_VECTOR_REQUIRES(HasAllocate, MM_VEC_REF.Allocate())
+MM_VECTOR_REQUIRES(HasLocalRegion,
+    (MM_VEC_REF.local_off(), MM_VEC_REF.local_size(), MM_VEC_REF.size()))
+MM_VECTOR_REQUIRES(HasSeqTx,
+    MM_VEC_REF.SeqTxBegin(size_t(), size_t(), u32()))
+MM_VECTOR_REQUIRES(HasPgasTx,
+    MM_VEC_REF.PgasTxBegin(size_t(), size_t(), u32()))
+MM_VECTOR_REQUIRES(HasRandTx,
+    MM_VEC_REF.RandTxBegin(size_t(), size_t(), size_t(), size_t(), u32()))
+MM_VECTOR_REQUIRES(HasTxEnd, MM_VEC_REF.TxEnd())
+MM_VECTOR_REQUIRES(HasAccess,
+    (MM_VEC_REF[size_t()], MM_VEC_REF.Read(size_t()),
+     MM_VEC_REF.Write(size_t())))
+MM_VECTOR_REQUIRES(HasAppend,
+    (MM_VEC_REF.emplace_back(MM_VEC_REF[size_t()]),
+     MM_VEC_REF.FlushEmplace(), MM_VEC_REF.FlushEmplace(MPI_Comm())))
+MM_VECTOR_REQUIRES(HasBarrier,
+    (MM_VEC_REF.Barrier(u32()), MM_VEC_REF.Barrier(u32(), MPI_Comm())))
+MM_VECTOR_REQUIRES(HasHint, MM_VEC_REF.Hint(u32()))
+MM_VECTOR_REQUIRES(HasDestroy, MM_VEC_REF.Destroy())
+
+#undef MM_VEC_REF
+#undef MM_VECTOR_REQUIRES
+
+/**
+ * The interface shared by the vector backends (VectorMegaMpi,
+ * VectorMmapMpi), so an application can be written once and run on
+ * either. A backend must support:
+ * 1. Init(path, count, flags) and InitComm(comm, path, count, flags)
+ * 2. BoundMemory, EvenPgas, Allocate, local_off, local_size, size
+ * 3. SeqTxBegin, PgasTxBegin, RandTxBegin, and TxEnd
+ * 4. operator[], Read, and Write
+ * 5. emplace_back and FlushEmplace (over the vector's comm, or another)
+ * 6. Barrier (over the vector's comm, or another), Hint, and Destroy
+ * */
+template<typename VecT>
+struct IsVectorBackend : std::conjunction<
+    HasInit<VecT>, HasCommInit<VecT>, HasBoundMemory<VecT>,
+    HasEvenPgas<VecT>, HasAllocate<VecT>, HasLocalRegion<VecT>,
+    HasSeqTx<VecT>, HasPgasTx<VecT>, HasRandTx<VecT>, HasTxEnd<VecT>,
+    HasAccess<VecT>, HasAppend<VecT>, HasBarrier<VecT>, HasHint<VecT>,
+    HasDestroy<VecT>> {};
+
+/** Whether VecT implements the vector interface */
+template<typename VecT>
+inline constexpr bool IsVectorBackendV = IsVectorBackend<VecT>::value;
+
+}  // namespace mm
+
+#endif  // MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_CONCEPT_H_
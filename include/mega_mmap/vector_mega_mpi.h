@@ -6,6 +6,11 @@
 #define MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_MEGA_MPI_H_
 
 #include <string>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <functional>
+#include <map>
 #include <mpi.h>
 #include <sys/mman.h>
 #include <fcntl.h>
@@ -19,6 +24,15 @@
 #include "data_stager/factory/stager_factory.h"
 #include "macros.h"
 #include "vector.h"
+#include "page_tuner.h"
+#include "node_cache.h"
+#include "rma_window.h"
+#include "reduce.h"
+#include "packed_page.h"
+#include "telemetry.h"
+#include "page_trace.h"
+#include "timeline.h"
+#include "source/data_source.h"
 
 #include "transaction/transaction.h"
 #include "transaction/seq_iter_tx.h"
@@ -34,12 +48,106 @@ struct Page {
   std::vector<T> elmts_;
   LPointer<hrunpq::TypedPushTask<hermes::GetBlobTask>> task_;
   u32 id_;
+  T *data_ = nullptr;   /**< The page frame (elmts_ or a node cache slot) */
+  int slot_ = -1;       /**< Node cache slot (-1 if private) */
+  size_t dirty_start_ = SIZE_MAX;  /**< First modified element */
+  size_t dirty_end_ = 0;           /**< Last modified element + 1 */
+  std::vector<u64> dirty_bits_;    /**< Modified elements (a bit each) */
+  bool prefetched_ = false;  /**< Faulted asynchronously, not yet accessed */
 
   Page() = default;
 
   Page(u32 id) : id_(id) {
     task_.ptr_ = nullptr;
   }
+
+  /**
+   * Copy a page. A private frame points to the copy's own elements.
+   * An async fault in flight is not copied (finish it first).
+   * */
+  Page(const Page &other) {
+    *this = other;
+  }
+
+  /** Copy a page */
+  Page& operator=(const Page &other) {
+    if (this != &other) {
+      elmts_ = other.elmts_;
+      task_.ptr_ = nullptr;
+      id_ = other.id_;
+      slot_ = other.slot_;
+      data_ = slot_ < 0 ? elmts_.data() : other.data_;
+      dirty_start_ = other.dirty_start_;
+      dirty_end_ = other.dirty_end_;
+      dirty_bits_ = other.dirty_bits_;
+      prefetched_ = false;
+    }
+    return *this;
+  }
+
+  /** Move a page (the frame of elmts_ moves with it) */
+  Page(Page &&other) = default;
+
+  /** Move a page */
+  Page& operator=(Page &&other) = default;
+
+  /**
+   * Record a modification of an element. Only modified elements are
+   * flushed, so ranks writing disjoint elements of a page in the same
+   * epoch never overwrite each other.
+   * */
+  void MarkDirty(size_t off) {
+    size_t word = off / 64;
+    if (word >= dirty_bits_.size()) {
+      dirty_bits_.resize(std::max(word + 1, (elmts_.size() + 63) / 64), 0);
+    }
+    dirty_bits_[word] |= ((u64)1) << (off % 64);
+    dirty_start_ = std::min(dirty_start_, off);
+    dirty_end_ = std::max(dirty_end_, off + 1);
+  }
+
+  /**
+   * Find the next run of modified elements at or after off
+   *
+   * @return false if no element after off was modified
+   * */
+  bool NextDirtyRun(size_t &off, size_t &count) const {
+    off = _FindBit(std::max(off, dirty_start_), true);
+    if (off >= dirty_end_) {
+      return false;
+    }
+    count = std::min(_FindBit(off, false), dirty_end_) - off;
+    return true;
+  }
+
+  /** The first element at or after off which is (or isn't) modified */
+  size_t _FindBit(size_t off, bool set) const {
+    size_t num_bits = dirty_bits_.size() * 64;
+    while (off < num_bits) {
+      u64 word = dirty_bits_[off / 64];
+      if (!set) {
+        word = ~word;
+      }
+      word &= ~((u64)0) << (off % 64);
+      if (word) {
+        return (off / 64) * 64 + __builtin_ctzll(word);
+      }
+      off = (off / 64 + 1) * 64;
+    }
+    return num_bits;
+  }
+
+  /** Whether the page has unflushed modifications */
+  bool IsDirty() const {
+    return dirty_end_ > dirty_start_;
+  }
+
+  /** Forget modifications once flushed */
+  void ClearDirty() {
+    dirty_start_ = SIZE_MAX;
+    dirty_end_ = 0;
+    dirty_bits_.clear();
+  }
 };
 
 /** A wrapper for mmap-based vectors */
@@ -53,10 +161,150 @@ class VectorMegaMpi : public Vector {
   std::string path_;       /**< The path being mapped into memory */
   std::shared_ptr<Tx> cur_tx_ = nullptr;   /**< The current access pattern transaction */
   size_t prefetch_gran_;
+  PageTuning tuning_;      /**< The automatic page size pick (MM_AUTO_PAGE) */
+  std::shared_ptr<DataSource> src_;  /**< Read-only source of pages */
+  u64 path_hash_ = 0;      /**< Key of this vector in the node cache */
+  u64 epoch_ = 0;          /**< Read-only epoch (bumped at each barrier) */
+  bool shared_ro_ = false; /**< Every rank treats the vector as read-only */
+  RmaWindow rma_;          /**< Exposes owned pages to other ranks */
+  bool dirty_on_access_ = false;  /**< Accesses may modify pages */
+  std::vector<size_t> epoch_dirty_;  /**< Pages flushed since last barrier */
+  bool rma_published_ = false;  /**< Owned pages are exposed by rma_ */
+  hermes::Bucket seg_bkt_;  /**< Private appended pages (MM_SCAN_APPEND) */
+  size_t seg_pages_ = 0;    /**< Pages in seg_bkt_ */
+  size_t append_base_ = 0;  /**< Elements appended before the last flush */
+  std::string bkt_name_;    /**< The Hermes bucket name */
+  std::vector<std::map<size_t, T>> acc_;  /**< Pending updates per owner */
+  std::function<T(const T&, const T&)> acc_op_;  /**< Combines updates */
+  VectorStats stats_;       /**< Page cache counters of this rank */
+  int trace_id_ = -1;       /**< Id in the page trace (-1 if not tracing) */
+  u64 tx_count_ = 0;        /**< Transactions ended so far */
+  const char *tx_span_ = nullptr;  /**< Timeline name of the current tx */
+  u64 tx_start_ns_ = 0;     /**< Timeline start of the current tx */
+  bool file_backed_ = false;  /**< Opened from a file or data source */
 
  public:
   VectorMegaMpi() = default;
-  ~VectorMegaMpi() = default;
+  ~VectorMegaMpi() {
+    MM_TELEMETRY->Retire(&stats_);
+  }
+
+  /**
+   * Copy constructor. The copy views the same bucket with its own
+   * counters and resident private pages. Pages still being faulted,
+   * node cache frames, pending appends and updates, the transaction,
+   * and the RMA windows stay with other.
+   * */
+  VectorMegaMpi(const VectorMegaMpi &other) : Vector(other) {
+    _Copy(other);
+  }
+
+  /** Copy assignment operator */
+  VectorMegaMpi& operator=(const VectorMegaMpi &other) {
+    if (this != &other) {
+      MM_TELEMETRY->Retire(&stats_);
+      Vector::operator=(other);
+      _Copy(other);
+    }
+    return *this;
+  }
+
+  /** Move constructor (the counters stay registered) */
+  VectorMegaMpi(VectorMegaMpi &&other) noexcept : Vector(other) {
+    _Move(other);
+  }
+
+  /** Move assignment operator */
+  VectorMegaMpi& operator=(VectorMegaMpi &&other) noexcept {
+    if (this != &other) {
+      MM_TELEMETRY->Retire(&stats_);
+      Vector::operator=(other);
+      _Move(other);
+    }
+    return *this;
+  }
+
+  /** Copy the configuration shared by copies and moves */
+  void _CopyConfig(const VectorMegaMpi &other) {
+    bkt_ = other.bkt_;
+    path_ = other.path_;
+    prefetch_gran_ = other.prefetch_gran_;
+    tuning_ = other.tuning_;
+    src_ = other.src_;
+    path_hash_ = other.path_hash_;
+    epoch_ = other.epoch_;
+    shared_ro_ = other.shared_ro_;
+    dirty_on_access_ = other.dirty_on_access_;
+    seg_bkt_ = other.seg_bkt_;
+    seg_pages_ = other.seg_pages_;
+    append_base_ = other.append_base_;
+    bkt_name_ = other.bkt_name_;
+    acc_op_ = other.acc_op_;
+    trace_id_ = other.trace_id_;
+    file_backed_ = other.file_backed_;
+  }
+
+  /** Copy other (see the copy constructor) */
+  void _Copy(const VectorMegaMpi &other) {
+    _CopyConfig(other);
+    data_.clear();
+    for (const std::pair<const size_t, Page<T>> &entry : other.data_) {
+      const Page<T> &page = entry.second;
+      if (page.task_.ptr_ == nullptr && page.slot_ < 0) {
+        data_.emplace(entry.first, page);
+      }
+    }
+    cur_memory_ = data_.size() * page_mem_;
+    append_data_.clear();
+    acc_.clear();
+    cur_page_ = nullptr;
+    cur_tx_ = nullptr;
+    rma_ = RmaWindow();
+    rma_published_ = false;
+    epoch_dirty_ = other.epoch_dirty_;
+    stats_ = VectorStats();
+    tx_count_ = 0;
+    tx_span_ = nullptr;
+    tx_start_ns_ = 0;
+    if (!path_.empty()) {
+      MM_TELEMETRY->Register(path_, &stats_);
+    }
+  }
+
+  /** Take over the pages, windows, and counters of other */
+  void _Move(VectorMegaMpi &other) {
+    _CopyConfig(other);
+    data_ = std::move(other.data_);
+    append_data_ = std::move(other.append_data_);
+    acc_ = std::move(other.acc_);
+    cur_page_ = other.cur_page_;
+    cur_tx_ = std::move(other.cur_tx_);
+    rma_ = other.rma_;
+    rma_published_ = other.rma_published_;
+    epoch_dirty_ = std::move(other.epoch_dirty_);
+    stats_ = other.stats_;
+    tx_count_ = other.tx_count_;
+    tx_span_ = other.tx_span_;
+    tx_start_ns_ = other.tx_start_ns_;
+    MM_TELEMETRY->Move(&other.stats_, &stats_);
+    other.data_.clear();
+    other.cur_page_ = nullptr;
+    other.cur_memory_ = 0;
+    other.rma_ = RmaWindow();
+    other.rma_published_ = false;
+  }
+
+  /**
+   * Initialize a vector shared by the ranks of comm. Barriers,
+   * flushes and PGAS splits then only involve comm, so sub-problems
+   * on disjoint communicators proceed independently. (A distinct
+   * name, since MPI_Comm is an int under MPICH.)
+   * */
+  template<typename ...Args>
+  void InitComm(MPI_Comm comm, Args&& ...args) {
+    comm_ = comm;
+    Init(std::forward<Args>(args)...);
+  }
 
   /** Explicit initializer */
   void Init(const std::string &path,
@@ -66,6 +314,7 @@ class VectorMegaMpi : public Vector {
       data_size = stdfs::file_size(path);
     }
     size_t size = data_size / sizeof(T);
+    file_backed_ = true;
     Init(path, size, flags);
   }
 
@@ -78,10 +327,10 @@ class VectorMegaMpi : public Vector {
   /** Explicit initializer */
   void Init(const std::string &path, size_t count,
             size_t elmt_size, u32 flags) {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &nprocs_);
     HILOG(kInfo, "{}: Mapping the dataset {}",
-          rank, path);
+          rank_, path);
 
     TRANSPARENT_HERMES();
     if (data_.size()) {
@@ -97,7 +346,57 @@ class VectorMegaMpi : public Vector {
     }
     pgas_.off_ = 0;
     pgas_.size_ = 0;
+    bkt_name_ = _ScopedName(path);
+    path_hash_ = NodeCache::HashPath(bkt_name_);
+    shared_ro_ = !flags_.Any(MM_WRITE_ONLY | MM_READ_WRITE | MM_APPEND_ONLY);
+    _ResetDirtyOnAccess();
     SetPageSize(MM_PAGE_SIZE);
+    MM_TELEMETRY->Register(path_, &stats_);
+    trace_id_ = MM_PAGE_TRACE->Define(path_, elmt_size_);
+  }
+
+  /** The page cache counters of this rank */
+  const VectorStats& GetStats() const {
+    return stats_;
+  }
+
+  /**
+   * Explicit initializer for a read-only vector whose pages are
+   * decoded from a data source (e.g., Parquet, Arrow IPC, HDF5).
+   * The path only names the Hermes bucket.
+   * */
+  void Init(const std::string &path,
+            const std::shared_ptr<DataSource> &src,
+            u32 flags) {
+    src_ = src;
+    file_backed_ = true;
+    Init(path, src->Size(), sizeof(T), flags | MM_READ_ONLY);
+    if (src_->PageElmts()) {
+      SetElmtsPerPage(src_->PageElmts());
+    }
+  }
+
+  /**
+   * The bucket name of a vector. Vectors of a sub-communicator created
+   * with a count (not opened from a file or source) are scoped to the
+   * group (by the world rank of its first rank), so groups reusing a
+   * name never share a bucket. This only depends on how the vector was
+   * initialized, so every rank of the group picks the same name.
+   * */
+  std::string _ScopedName(const std::string &path) const {
+    int world_nprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_nprocs);
+    if (nprocs_ == world_nprocs || file_backed_) {
+      return path;
+    }
+    MPI_Group group, world_group;
+    MPI_Comm_group(comm_, &group);
+    MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    int first = 0, world_first;
+    MPI_Group_translate_ranks(group, 1, &first, world_group, &world_first);
+    MPI_Group_free(&world_group);
+    MPI_Group_free(&group);
+    return hshm::Formatter::format("{}@{}_{}", path, world_first, nprocs_);
   }
 
   /** Resize this DSM */
@@ -113,9 +412,13 @@ class VectorMegaMpi : public Vector {
     prefetch_gran_ = elmts_per_window_ * .5;
   }
 
-  /** Set the exact size in bytes of a DSM page */
+  /**
+   * Set the exact size in bytes of a DSM page. Complex types get one
+   * element per page, unless MM_PACKED packs elements of the average
+   * size (elmt_size_) into the page.
+   * */
   void SetPageSize(size_t page_size) {
-    if (!IS_COMPLEX_TYPE) {
+    if (!IS_COMPLEX_TYPE || flags_.Any(MM_PACKED)) {
       elmts_per_page_ = page_size / elmt_size_;
       if (elmts_per_page_ == 0) {
         elmts_per_page_ = 1;
@@ -146,24 +449,230 @@ class VectorMegaMpi : public Vector {
                elmts_per_page_);
   }
 
-  /** Allocate the DSM */
+  /** Evenly split DSM among the ranks of the vector's communicator */
+  void EvenPgas(size_t max_count,
+                PgasLayout layout = PgasLayout::kEven,
+                size_t count_per_page = 0) {
+    EvenPgas(rank_, nprocs_, max_count, layout, count_per_page);
+  }
+
+  /**
+   * Split DSM among processes with a layout. kPageAligned and
+   * kBlockCyclic split whole pages, so no page has two writers.
+   * */
+  void EvenPgas(int rank, int nprocs, size_t max_count,
+                PgasLayout layout, size_t count_per_page = 0) {
+    if (count_per_page != 0) {
+      SetElmtsPerPage(count_per_page);
+    }
+    switch (layout) {
+      case PgasLayout::kEven: {
+        bounds_.EvenSplit(rank, nprocs, max_count);
+        break;
+      }
+      case PgasLayout::kPageAligned: {
+        bounds_.AlignedSplit(rank, nprocs, max_count, elmts_per_page_);
+        break;
+      }
+      case PgasLayout::kWeighted: {
+        std::vector<double> weights(nprocs, 1);
+        bounds_.WeightedSplit(rank, nprocs, max_count,
+                              elmts_per_page_, weights);
+        break;
+      }
+      case PgasLayout::kBlockCyclic: {
+        bounds_.BlockCyclic(rank, nprocs, max_count, elmts_per_page_);
+        break;
+      }
+    }
+    pgas_.Init(bounds_.off_, bounds_.size_, elmts_per_page_);
+  }
+
+  /**
+   * Split whole pages of DSM among the processes of comm in proportion
+   * to weight (e.g., memory capacity or throughput) (collective)
+   * */
+  void WeightedPgas(MPI_Comm comm, double weight, size_t max_count,
+                    size_t count_per_page = 0) {
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    std::vector<double> weights(nprocs);
+    MPI_Allgather(&weight, 1, MPI_DOUBLE,
+                  weights.data(), 1, MPI_DOUBLE, comm);
+    if (count_per_page != 0) {
+      SetElmtsPerPage(count_per_page);
+    }
+    bounds_.WeightedSplit(rank, nprocs, max_count, elmts_per_page_, weights);
+    pgas_.Init(bounds_.off_, bounds_.size_, elmts_per_page_);
+  }
+
+  /**
+   * Choose the page size from the declared access pattern
+   * (MM_SEQ_ACCESS, MM_RAND_ACCESS, MM_PGAS_ACCESS), the element size,
+   * the window size, and a probe of the backend. The pick is stored in
+   * tuning_ and can be reproduced with SetPageSize(tuning_.page_size_).
+   * Collective over comm_: rank 0 probes and broadcasts the pick, so
+   * every rank sharing the bucket uses the same pages.
+   * */
+  void AutoPageSize() {
+    u32 pattern = flags_.bits_ &
+        (MM_SEQ_ACCESS | MM_RAND_ACCESS | MM_PGAS_ACCESS);
+    if (rank_ == 0) {
+      tuning_ = PageTuner::Tune(bkt_name_, pattern, elmt_size_,
+                                window_size_, max_size_);
+    }
+    MPI_Bcast(&tuning_, sizeof(PageTuning), MPI_BYTE, 0, comm_);
+    SetPageSize(tuning_.page_size_);
+    if (pgas_.size_) {
+      bounds_.Resplit(elmts_per_page_);
+      pgas_.Init(bounds_.off_, bounds_.size_, elmts_per_page_);
+    }
+    if (rank_ == 0) {
+      HILOG(kInfo, "Tuned page size of {}: {}",
+            path_, tuning_.ToString());
+    }
+  }
+
+  /** Allocate the DSM (collective over comm_ with MM_AUTO_PAGE) */
   void Allocate() {
+    if (flags_.Any(MM_AUTO_PAGE)) {
+      AutoPageSize();
+    }
     hermes::Context ctx;
     if constexpr(!IS_COMPLEX_TYPE) {
-      bitfield32_t flags;
-      if (!flags_.Any(MM_STAGE)) {
-        flags.SetBits(HERMES_STAGE_NO_READ);
+      if (!src_) {
+        bitfield32_t flags;
+        if (!flags_.Any(MM_STAGE)) {
+          flags.SetBits(HERMES_STAGE_NO_READ);
+        }
+        ctx = hermes::data_stager::BinaryFileStager::BuildContext(
+            page_size_, flags.bits_, elmt_size_);
       }
-      ctx = hermes::data_stager::BinaryFileStager::BuildContext(
-          page_size_, flags.bits_, elmt_size_);
     }
-    bkt_ = HERMES->GetBucket(path_, ctx);
+    bkt_ = HERMES->GetBucket(bkt_name_, ctx);
     append_data_.reserve(elmts_per_page_);
 
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     HILOG(kInfo, "{}: Allocated the dataset {} of size {}",
-          rank, path_, size_);
+          rank_, bkt_name_, size_);
+  }
+
+  /** Stage in over the vector's communicator */
+  void StageIn() {
+    StageIn(comm_);
+  }
+
+  /**
+   * Collectively read the local PGAS partition from the backing file
+   * (after EvenPgas and Allocate). Partitions are read in rounds of
+   * large page-aligned MPI-IO collective reads, so the filesystem sees
+   * aggregated two-phase I/O instead of per-page faults. The first
+   * window of pages stays resident; the rest are put in Hermes.
+   *
+   * @param comm The ranks which share the file
+   * @param round_size Max bytes read by a rank per round (0: window size)
+   * */
+  void StageIn(MPI_Comm comm, size_t round_size = 0) {
+    if constexpr (IS_COMPLEX_TYPE) {
+      return;
+    } else {
+      if (src_ || !stdfs::exists(path_)) {
+        return;
+      }
+      // Pages overlapping the local partition
+      size_t min_page = 0, num_pages = 0;
+      if (pgas_.size_) {
+        min_page = pgas_.min_page_idx_;
+        num_pages = (local_last() + elmts_per_page_ - 1) /
+            elmts_per_page_ - min_page;
+      }
+      if (round_size == 0) {
+        round_size = window_size_ ? window_size_ : MEGABYTES(64);
+      }
+      size_t pages_per_round = std::max<size_t>(round_size / page_size_, 1);
+      pages_per_round = std::min<size_t>(pages_per_round,
+                                         INT_MAX / page_size_);
+      u64 my_rounds = (num_pages + pages_per_round - 1) / pages_per_round;
+      u64 rounds = 0;
+      MPI_Allreduce(&my_rounds, &rounds, 1, MPI_UINT64_T, MPI_MAX, comm);
+
+      // Enable collective buffering (two-phase I/O)
+      MPI_Info info;
+      MPI_Info_create(&info);
+      MPI_Info_set(info, "romio_cb_read", "enable");
+      MPI_File fh;
+      MPI_File_open(comm, path_.c_str(), MPI_MODE_RDONLY, info, &fh);
+      MPI_Info_free(&info);
+
+      std::vector<char> buf(pages_per_round * page_size_);
+      for (u64 round = 0; round < rounds; ++round) {
+        size_t first = std::min(round * pages_per_round, num_pages);
+        size_t count = std::min(pages_per_round, num_pages - first);
+        MPI_Status status;
+        MPI_File_read_at_all(fh, (min_page + first) * page_size_,
+                             buf.data(), (int)(count * page_size_),
+                             MPI_BYTE, &status);
+        int nbytes;
+        MPI_Get_count(&status, MPI_BYTE, &nbytes);
+        memset(buf.data() + nbytes, 0, count * page_size_ - nbytes);
+        for (size_t i = 0; i < count; ++i) {
+          _StagePage(min_page + first + i, buf.data() + i * page_size_);
+        }
+      }
+      MPI_File_close(&fh);
+      int rank;
+      MPI_Comm_rank(comm, &rank);
+      HILOG(kInfo, "{}: Staged {} pages of {} in {} rounds",
+            rank, num_pages, path_, rounds);
+    }
+  }
+
+  /**
+   * Keep a staged page resident if it fits in the window (a window of
+   * 0 is unbounded)
+   * */
+  void _StagePage(size_t page_idx, char *data) {
+    if (data_.find(page_idx) != data_.end()) {
+      return;
+    }
+    if (window_size_ == 0 || cur_memory_ + page_mem_ <= window_size_) {
+      data_.emplace(page_idx, Page<T>(page_idx));
+      Page<T> &page = data_[page_idx];
+      page.elmts_.resize(elmts_per_page_);
+      page.data_ = page.elmts_.data();
+      // Staged bytes are the backend format of T, like a faulted blob
+      memcpy(static_cast<void*>(page.data_), data, page_size_);
+      _Charge(page_mem_);
+    } else {
+      hermes::Context ctx;
+      std::string page_name =
+          hermes::adapter::BlobPlacement::CreateBlobName(page_idx).str();
+      hermes::Blob blob(data, page_size_);
+      bkt_.Put(page_name, blob, ctx);
+    }
+  }
+
+  /**
+   * Let ranks read pages of other ranks' PGAS regions directly from
+   * the owner's memory with MPI-3 RMA (collective, after EvenPgas).
+   * Owned pages stay resident while they fit in the window, and during
+   * a read-only epoch (Barrier with MM_READ_ONLY) they are pinned and
+   * exposed. Faults fall back to the backend if an owner evicted a page.
+   * */
+  void EnableRma(MPI_Comm comm) {
+    if constexpr (!IS_COMPLEX_TYPE) {
+      size_t first_page = 0, num_pages = 0;
+      if (pgas_.size_) {
+        first_page = pgas_.min_page_idx_;
+        num_pages = (local_last() - 1) / elmts_per_page_ - first_page + 1;
+      }
+      rma_.Init(comm, first_page, num_pages);
+    }
+  }
+
+  /** Enable RMA over the vector's communicator */
+  void EnableRma() {
+    EnableRma(comm_);
   }
 
   /** Create a sequential transaction */
@@ -171,8 +680,10 @@ class VectorMegaMpi : public Vector {
     if (flags_.Any(MM_STAGE)) {
       flags |= MM_STAGE;
     }
+    _BeginTxSpan("SeqTx");
     cur_tx_ = std::make_shared<SeqIterTx>(
         this, off, size, flags);
+    dirty_on_access_ = flags & (MM_WRITE_ONLY | MM_READ_WRITE);
   }
 
   /** Create a PGAS transaction */
@@ -180,8 +691,10 @@ class VectorMegaMpi : public Vector {
     if (flags_.Any(MM_STAGE)) {
       flags |= MM_STAGE;
     }
+    _BeginTxSpan("PgasTx");
     cur_tx_ = std::make_shared<PgasTx>(
         this, off, size, flags);
+    dirty_on_access_ = flags & (MM_WRITE_ONLY | MM_READ_WRITE);
   }
 
   /** Create a random transaction */
@@ -190,13 +703,16 @@ class VectorMegaMpi : public Vector {
     if (flags_.Any(MM_STAGE)) {
       flags |= MM_STAGE;
     }
+    _BeginTxSpan("RandTx");
     cur_tx_ = std::make_shared<RandIterTx>(
         this, seed, rand_left, rand_size, size, flags);
+    dirty_on_access_ = flags & (MM_WRITE_ONLY | MM_READ_WRITE);
   }
 
   /** Begin an arbitrary transaction */
   template<typename TxT, typename ...Args>
   void TxBegin(Args&& ...args) {
+    _BeginTxSpan("Tx");
     cur_tx_ = std::make_shared<TxT>(
         this, std::forward<Args>(args)...);
   }
@@ -225,30 +741,121 @@ class VectorMegaMpi : public Vector {
   void TxEnd() {
     cur_tx_->ProcessLog(true);
     cur_tx_ = nullptr;
+    if (tx_span_) {
+      MM_TIMELINE->Record(tx_span_, "tx", tx_start_ns_, tx_count_ + 1);
+      tx_span_ = nullptr;
+    }
+    ++tx_count_;
+    _ResetDirtyOnAccess();
+  }
+
+  /** Start the timeline span of a transaction (ends at TxEnd) */
+  void _BeginTxSpan(const char *name) {
+    if (MM_TIMELINE->IsEnabled()) {
+      tx_span_ = name;
+      tx_start_ns_ = MM_TIMELINE->Now();
+    }
   }
 
-  /** Flush data to backend */
-  void _Flush(size_t page_idx, size_t mod_start, size_t mod_count) {
+  /** Outside of transactions, writes are expected unless read-only */
+  void _ResetDirtyOnAccess() {
+    dirty_on_access_ = !shared_ro_;
+  }
+
+  /**
+   * Flush the modified elements of a page to the backend. Plain types
+   * write each modified run; complex types re-serialize the whole page,
+   * so their pages must have one writer per epoch.
+   * */
+  void _Flush(size_t page_idx) {
     hermes::Context ctx;
     auto it = data_.find(page_idx);
-    if (it == data_.end()) {
+    if (it == data_.end() || it->second.slot_ >= 0 ||
+        !it->second.IsDirty()) {
       return;
     }
+    MM_SPAN("Flush", "io", page_idx);
     Page<T> &page = it->second;
     if constexpr (!IS_COMPLEX_TYPE) {
       std::string page_name =
           hermes::adapter::BlobPlacement::CreateBlobName(page_idx).str();
       ctx.flags_.SetBits(HERMES_SHOULD_STAGE);
-      hermes::Blob blob((char*)page.elmts_.data() + mod_start * elmt_size_,
-                        mod_count * elmt_size_);
-      bkt_.PartialPut(page_name, blob, mod_start * elmt_size_, ctx);
+      size_t off = 0, count = 0;
+      while (page.NextDirtyRun(off, count)) {
+        hermes::Blob blob((char*)page.elmts_.data() + off * elmt_size_,
+                          count * elmt_size_);
+        bkt_.PartialPut(page_name, blob, off * elmt_size_, ctx);
+        stats_.bytes_out_ += count * elmt_size_;
+        off += count;
+      }
     } else {
       std::string page_name =
           hermes::adapter::BlobPlacement::CreateBlobName(page_idx).str();
-      bkt_.Put<T>(page_name, page.elmts_[0], ctx);
+      if (flags_.Any(MM_PACKED)) {
+        _FlushPacked(page, page_idx, page_name, ctx);
+      } else {
+        bkt_.Put<T>(page_name, page.elmts_[0], ctx);
+        stats_.bytes_out_ += page_size_;
+      }
+    }
+    ++stats_.flushes_;
+    page.ClearDirty();
+    epoch_dirty_.emplace_back(page_idx);
+  }
+
+  /**
+   * Serialize a whole packed page (element sizes may have changed).
+   * Pages must have one writer per epoch, e.g., a page-aligned PGAS.
+   * */
+  void _FlushPacked(Page<T> &page, size_t page_idx,
+                    const std::string &page_name, hermes::Context &ctx) {
+    size_t count = std::min(elmts_per_page_,
+                            size_ - page_idx * elmts_per_page_);
+    std::string primary, overflow;
+    bool overflows = PackedPage<T>::Pack(page.elmts_.data(), count,
+                                         page_size_, primary, overflow);
+    hermes::Blob blob(primary.data(), primary.size());
+    bkt_.Put(page_name, blob, ctx);
+    stats_.bytes_out_ += primary.size() + overflow.size();
+    if (overflows) {
+      hermes::Blob ovf_blob(overflow.data(), overflow.size());
+      bkt_.Put(page_name + "_ovf", ovf_blob, ctx);
+      MM_TRACE("{}: Page {} of {} overflows by {} bytes",
+               rank_, page_idx, path_, overflow.size());
+    } else {
+      // The page shrank: drop the overflow of an earlier flush
+      hermes::BlobId ovf_id = bkt_.GetBlobId(page_name + "_ovf");
+      if (!ovf_id.IsNull()) {
+        bkt_.DestroyBlob(ovf_id, ctx);
+      }
+    }
+  }
+
+  /** Deserialize a packed page */
+  void _FaultPacked(Page<T> &page, const std::string &page_name,
+                    hermes::Context &ctx) {
+    hermes::Blob blob;
+    bkt_.Get(page_name, blob, ctx);
+    std::string overflow;
+    if (PackedPage<T>::Overflows(blob.data(), blob.size())) {
+      hermes::Blob ovf_blob;
+      bkt_.Get(page_name + "_ovf", ovf_blob, ctx);
+      overflow.assign(ovf_blob.data(), ovf_blob.size());
+    }
+    PackedPage<T>::Unpack(blob.data(), blob.size(), overflow,
+                          page.elmts_.data(), page.elmts_.size());
+  }
+
+  /** Flush the modified part of every resident page */
+  void _FlushDirty() {
+    for (auto &[page_idx, page] : data_) {
+      if (page.IsDirty()) {
+        _Flush(page_idx);
+      }
     }
   }
 
+
   /** Serialize the in-memory cache back to backend */
   void _Evict(size_t page_idx) {
     auto it = data_.find(page_idx);
@@ -259,26 +866,415 @@ class VectorMegaMpi : public Vector {
       cur_page_ = nullptr;
     }
     Page<T> &page = it->second;
+    if (page.slot_ >= 0) {
+      MM_NODE_CACHE->Release(page.slot_);
+      data_.erase(it);
+      cur_memory_ -= _SharedPageMem();
+      ++stats_.evictions_;
+      return;
+    }
+    if (_RmaRetain(page_idx)) {
+      return;
+    }
     FinishAsyncFault<true>(page);
     data_.erase(it);
-    cur_memory_ -= page_size_;
+    cur_memory_ -= page_mem_;
+    ++stats_.evictions_;
   }
 
-  /** Lock a region */
+  /** Record an event in the page trace */
+  void _Trace(PageTraceOp op, size_t idx, size_t count) {
+    MM_PAGE_TRACE->Record(trace_id_, op, idx, count,
+                          cur_tx_ ? tx_count_ + 1 : 0);
+  }
+
+  /** Account for a page entering memory */
+  void _Charge(size_t bytes) {
+    cur_memory_ += bytes;
+    stats_.Peak(cur_memory_);
+  }
+
+  /** Barrier over the vector's communicator */
+  void Barrier(u32 flags) {
+    Barrier(flags, comm_);
+  }
+
+  /**
+   * Lock a region. Modified pages are flushed (release), the pages each
+   * rank flushed since the last barrier are exchanged, and resident
+   * pages which another rank modified are dropped (acquire). Pages no
+   * other rank modified stay resident across the barrier.
+   * */
   void Barrier(u32 flags, MPI_Comm comm) {
-    MPI_Barrier(comm);
+    MM_SPAN("Barrier", "sync", flags);
+    _ReleaseShared();
+    if (flags_.Any(MM_ACCUMULATE)) {
+      _ShipAccumulate(comm);
+    }
+    _FlushDirty();
+    std::vector<size_t> modified = _ExchangeDirty(comm);
+    if (rma_published_) {
+      rma_.Unpublish();
+      rma_published_ = false;
+    }
+    _Invalidate(modified);
     flags_.SetBits(flags);
+    shared_ro_ = flags & MM_READ_ONLY;
+    _ResetDirtyOnAccess();
+    if (flags_.Any(MM_NODE_SHARED)) {
+      _NextEpoch();
+    }
+    if (rma_.IsInitialized()) {
+      _RmaEpoch(flags & MM_READ_ONLY);
+    }
+  }
+
+  /**
+   * Gather the pages every other rank flushed since the last barrier
+   * (collective; also synchronizes the ranks like MPI_Barrier)
+   * */
+  std::vector<size_t> _ExchangeDirty(MPI_Comm comm) {
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    std::sort(epoch_dirty_.begin(), epoch_dirty_.end());
+    epoch_dirty_.erase(std::unique(epoch_dirty_.begin(), epoch_dirty_.end()),
+                       epoch_dirty_.end());
+    int count = (int)epoch_dirty_.size();
+    std::vector<int> counts(nprocs), displs(nprocs);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+    int total = 0;
+    for (int i = 0; i < nprocs; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+    std::vector<size_t> all(total);
+    MPI_Allgatherv(epoch_dirty_.data(), count, MPI_UINT64_T,
+                   all.data(), counts.data(), displs.data(),
+                   MPI_UINT64_T, comm);
+    epoch_dirty_.clear();
+    // Our own flushes do not make our copies stale
+    std::vector<size_t> modified;
+    for (int i = 0; i < nprocs; ++i) {
+      if (i == rank) {
+        continue;
+      }
+      modified.insert(modified.end(), all.begin() + displs[i],
+                      all.begin() + displs[i] + counts[i]);
+    }
+    return modified;
+  }
+
+  /** Set the operator which combines accumulated updates */
+  template<typename OpT>
+  void SetAccumulateOp(OpT op) {
+    acc_op_ = op;
+  }
+
+  /**
+   * Combine val into the element at idx with op (owner computes).
+   * Updates to elements of other ranks' PGAS regions are combined
+   * locally and shipped to their owner at the next Barrier, which
+   * applies them to its own pages. Scattered updates thus never fault
+   * remote pages. The vector must be initialized with MM_ACCUMULATE,
+   * and every rank which may receive updates must know op (from
+   * Accumulate or SetAccumulateOp).
+   * */
+  template<typename OpT>
+  void Accumulate(size_t idx, const T &val, OpT op) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be accumulated");
+    if (!acc_op_) {
+      acc_op_ = op;
+    }
+    int owner = bounds_.max_size_ ? OwnerOf(idx) : rank_;
+    if (owner == rank_) {
+      T &elmt = Write(idx);
+      elmt = op(elmt, val);
+      return;
+    }
+    if (acc_.empty()) {
+      acc_.resize(nprocs_);
+    }
+    std::map<size_t, T> &updates = acc_[owner];
+    auto it = updates.find(idx);
+    if (it == updates.end()) {
+      updates.emplace(idx, val);
+    } else {
+      it->second = op(it->second, val);
+    }
+  }
+
+  /**
+   * Send pending updates to their owners and apply received ones.
+   * Updates are counted in elements of an MPI type, so a rank may
+   * exchange up to INT_MAX updates (not bytes) per barrier.
+   * */
+  void _ShipAccumulate(MPI_Comm comm) {
+    if constexpr (!IS_COMPLEX_TYPE) {
+      struct Update {
+        size_t idx_;
+        T val_;
+      };
+      int nprocs;
+      MPI_Comm_size(comm, &nprocs);
+      std::vector<Update> send;
+      std::vector<int> send_counts(nprocs, 0), send_displs(nprocs, 0);
+      for (int i = 0; i < (int)acc_.size() && i < nprocs; ++i) {
+        send_displs[i] = (int)send.size();
+        for (auto &[idx, val] : acc_[i]) {
+          send.emplace_back(Update{idx, val});
+        }
+        if (send.size() > INT_MAX) {
+          HELOG(kFatal, "{}: Too many pending updates to {} ({})",
+                rank_, path_, send.size());
+        }
+        send_counts[i] = (int)send.size() - send_displs[i];
+      }
+      acc_.clear();
+      MPI_Datatype update_type;
+      MPI_Type_contiguous(sizeof(Update), MPI_BYTE, &update_type);
+      MPI_Type_commit(&update_type);
+      std::vector<int> recv_counts(nprocs), recv_displs(nprocs);
+      MPI_Alltoall(send_counts.data(), 1, MPI_INT,
+                   recv_counts.data(), 1, MPI_INT, comm);
+      size_t total = 0;
+      for (int i = 0; i < nprocs; ++i) {
+        recv_displs[i] = (int)total;
+        total += recv_counts[i];
+      }
+      if (total > INT_MAX) {
+        HELOG(kFatal, "{}: Too many updates received for {} ({})",
+              rank_, path_, total);
+      }
+      std::vector<Update> recv(total);
+      MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(),
+                    update_type, recv.data(), recv_counts.data(),
+                    recv_displs.data(), update_type, comm);
+      MPI_Type_free(&update_type);
+      if (recv.empty()) {
+        return;
+      }
+      if (!acc_op_) {
+        HELOG(kFatal, "{}: Received updates for {} without an operator",
+              rank_, path_);
+      }
+      // Apply in page order
+      std::sort(recv.begin(), recv.end(),
+                [](const Update &a, const Update &b) {
+                  return a.idx_ < b.idx_;
+                });
+      for (Update &update : recv) {
+        T &elmt = Write(update.idx_);
+        elmt = acc_op_(elmt, update.val_);
+      }
+      HILOG(kDebug, "{}: Applied {} updates to {}",
+            rank_, recv.size(), path_);
+    }
+  }
+
+  /** Drop resident pages modified by other ranks */
+  void _Invalidate(const std::vector<size_t> &modified) {
+    for (size_t page_idx : modified) {
+      auto it = data_.find(page_idx);
+      if (it == data_.end()) {
+        continue;
+      }
+      if (cur_page_ == &it->second) {
+        cur_page_ = nullptr;
+      }
+      size_t mem = it->second.slot_ >= 0 ? _SharedPageMem() : page_mem_;
+      FinishAsyncFault<true>(it->second);
+      data_.erase(it);
+      cur_memory_ -= mem;
+    }
+  }
+
+  /**
+   * Whether a page holds elements of the local PGAS region. Block-cyclic
+   * regions are not contiguous, so each run of the page is checked.
+   * */
+  bool _IsOwnedPage(size_t page_idx) const {
+    if (page_idx < rma_.first_page_ ||
+        page_idx >= rma_.first_page_ + rma_.num_pages_) {
+      return false;
+    }
+    size_t start = page_idx * elmts_per_page_;
+    size_t end = std::min(start + elmts_per_page_, bounds_.max_size_);
+    for (size_t i = start; i < end; i = bounds_.RunEnd(i)) {
+      if (bounds_.OwnerOf(i) == bounds_.rank_) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Owned pages are kept resident for RMA readers. They are pinned
+   * while exposed, and otherwise kept while they fit in the window.
+   * */
+  bool _RmaRetain(size_t page_idx) const {
+    if (!rma_.IsInitialized() || !_IsOwnedPage(page_idx)) {
+      return false;
+    }
+    return rma_published_ || window_size_ == 0 ||
+        cur_memory_ <= window_size_;
+  }
+
+  /** Begin an RMA epoch (after the barrier of every rank) */
+  void _RmaEpoch(bool read_only) {
+    if (rma_published_) {
+      rma_.Unpublish();
+      rma_published_ = false;
+    }
+    if (!read_only) {
+      return;
+    }
+    for (auto &[page_idx, page] : data_) {
+      if (_IsOwnedPage(page_idx)) {
+        rma_.Publish(page_idx, (char *) page.data_, page_size_);
+      }
+    }
+    rma_.Sync();
+    MPI_Barrier(rma_.comm_);
+    rma_published_ = true;
+    // Owned pages may also hold the elements of neighboring ranks
+    for (auto &[page_idx, page] : data_) {
+      if (_IsOwnedPage(page_idx)) {
+        _FaultRma(page, page_idx, true);
+      }
+    }
+  }
+
+  /**
+   * Read the elements of a page from the ranks which own them
+   *
+   * @param skip_local Whether to keep the elements this rank owns
+   * @return false if some owner does not have the page resident
+   * */
+  bool _FaultRma(Page<T> &page, size_t page_idx, bool skip_local) {
+    char *buf = (char *) page.data_;
+    size_t start = page_idx * elmts_per_page_;
+    size_t end = std::min(start + elmts_per_page_, bounds_.max_size_);
+    std::vector<char> backend;
+    for (size_t i = start; i < end;) {
+      int owner = bounds_.OwnerOf(i);
+      size_t owner_off = bounds_.RegionOf(owner).first;
+      size_t last = std::min(end, bounds_.RunEnd(i));
+      size_t off = (i - start) * elmt_size_;
+      size_t size = (last - i) * elmt_size_;
+      if (owner == bounds_.rank_) {
+        if (!skip_local) {
+          return false;
+        }
+      } else if (!rma_.Fetch(owner, owner_off / elmts_per_page_,
+                             page_idx, off, size, buf + off)) {
+        if (!skip_local) {
+          return false;
+        }
+        // The owner evicted (and flushed) the page
+        if (backend.empty()) {
+          backend.resize(page_size_);
+          hermes::Context ctx;
+          hermes::Blob blob(backend.data(), page_size_);
+          bkt_.Get(hermes::adapter::BlobPlacement::CreateBlobName(
+              page_idx).str(), blob, ctx);
+        }
+        memcpy(buf + off, backend.data() + off, size);
+      }
+      i = last;
+    }
+    return true;
   }
 
   /** Hint access pattern */
   void Hint(u32 flags) {
     flags_.SetBits(flags);
+    if (flags & (MM_WRITE_ONLY | MM_READ_WRITE | MM_APPEND_ONLY)) {
+      _ReleaseShared();
+      shared_ro_ = false;
+    } else if (flags & MM_READ_ONLY) {
+      shared_ro_ = true;
+    }
+    if (!cur_tx_) {
+      _ResetDirtyOnAccess();
+    }
+  }
+
+  /**
+   * Whether faults map pages from the node cache. Only plain types are
+   * shared, and only while every rank treats the vector as read-only.
+   * */
+  bool _IsNodeShared() const {
+    if constexpr (IS_COMPLEX_TYPE) {
+      return false;
+    } else {
+      return shared_ro_ && flags_.Any(MM_NODE_SHARED) &&
+          MM_NODE_CACHE->Fits(page_size_);
+    }
+  }
+
+  /** Memory charged to this rank for a node cache page */
+  size_t _SharedPageMem() const {
+    return sizeof(Page<T>) + page_size_ / MM_NODE_CACHE->node_nprocs_;
+  }
+
+  /** Unmap all pages mapped from the node cache */
+  void _ReleaseShared() {
+    for (auto it = data_.begin(); it != data_.end();) {
+      if (it->second.slot_ >= 0) {
+        if (cur_page_ == &it->second) {
+          cur_page_ = nullptr;
+        }
+        MM_NODE_CACHE->Release(it->second.slot_);
+        cur_memory_ -= _SharedPageMem();
+        it = data_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /** Begin a new epoch, so stale shared pages are never mapped */
+  void _NextEpoch() {
+    ++epoch_;
+    if (MM_NODE_CACHE->IsInitialized()) {
+      MM_NODE_CACHE->Invalidate(path_hash_, epoch_);
+    }
+  }
+
+  /** Map a page from the node cache, faulting it if no rank has */
+  bool _FaultShared(Page<T> &page, size_t page_idx,
+                    const std::string &page_name) {
+    char *frame = MM_NODE_CACHE->Acquire(
+        path_hash_, epoch_, page_idx, page.slot_,
+        [&](char *buf) {
+          if (src_) {
+            size_t off = page_idx * elmts_per_page_;
+            size_t count = std::min(elmts_per_page_, size_ - off);
+            src_->Read(off, count, buf);
+          } else {
+            hermes::Context ctx;
+            if (flags_.Any(MM_STAGE)) {
+              ctx.flags_.SetBits(HERMES_SHOULD_STAGE);
+            }
+            hermes::Blob blob(buf, page_size_);
+            bkt_.Get(page_name, blob, ctx);
+          }
+        });
+    if (frame == nullptr) {
+      return false;
+    }
+    page.data_ = reinterpret_cast<T*>(frame);
+    _Charge(_SharedPageMem());
+    stats_.In(PageSource::kNodeCache, page_size_);
+    return true;
   }
 
   /** Finish async fault */
   template<bool InEvict>
   void FinishAsyncFault(Page<T> &page) {
     if (page.task_.ptr_ != nullptr) {
+      MM_SPAN("AsyncFaultWait", "io", page.id_);
       page.task_->Wait();
       hermes::GetBlobTask *task = page.task_->get();
       if constexpr(!InEvict) {
@@ -296,24 +1292,47 @@ class VectorMegaMpi : public Vector {
   Page<T>* _Fault(size_t page_idx) {
     // Ensure that the page_idx makes sense
     if (page_idx > size_ / elmts_per_page_) {
-      int rank;
-      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
       HELOG(kError, "{}: Cannot seek past size of {}: {} / {} ",
-            rank, path_, page_idx, size_ / elmts_per_page_);
+            rank_, path_, page_idx, size_ / elmts_per_page_);
       return nullptr;
     }
     if (data_.find(page_idx) != data_.end()) {
       return &data_[page_idx];
     }
+    MM_SPAN("Fault", "io", page_idx);
 
     // Add page to page table
     hermes::Context ctx;
+    ++stats_.faults_;
     data_.emplace(page_idx, Page<T>(page_idx));
     Page<T> &page = data_[page_idx];
-    page.elmts_.resize(elmts_per_page_);
     std::string page_name =
         hermes::adapter::BlobPlacement::CreateBlobName(page_idx).str();
 
+    // Map the page from the node cache
+    if (_IsNodeShared() && _FaultShared(page, page_idx, page_name)) {
+      return &page;
+    }
+    page.elmts_.resize(elmts_per_page_);
+    page.data_ = page.elmts_.data();
+
+    // Read the page from the memory of the ranks which own it
+    if (rma_published_ && _FaultRma(page, page_idx, false)) {
+      _Charge(page_mem_);
+      stats_.In(PageSource::kRma, page_size_);
+      return &page;
+    }
+
+    // Decode the page from the data source
+    if (src_) {
+      size_t off = page_idx * elmts_per_page_;
+      size_t count = std::min(elmts_per_page_, size_ - off);
+      src_->Read(off, count, (char *) page.elmts_.data());
+      _Charge(page_mem_);
+      stats_.In(PageSource::kDataSource, count * elmt_size_);
+      return &page;
+    }
+
     // If we need to read data from the page, ensure we read it from Hermes
     if (flags_.Any(MM_READ_ONLY | MM_READ_WRITE)) {
       if constexpr (!IS_COMPLEX_TYPE) {
@@ -325,31 +1344,80 @@ class VectorMegaMpi : public Vector {
           bkt_.Get(page_name, blob, ctx);
         } else {
           page.task_ = bkt_.AsyncGet(page_name, blob, ctx);
+          page.prefetched_ = true;
         }
+      } else if (flags_.Any(MM_PACKED)) {
+        _FaultPacked(page, page_name, ctx);
       } else {
         bkt_.Get<T>(page_name, page.elmts_[0], ctx);
       }
+      stats_.In(PageSource::kBackend, page_size_);
     }
 
     // Increment the current memory counter
-    cur_memory_ += page_mem_;
+    _Charge(page_mem_);
     return &page;
   }
 
   /** Index operator */
   T& operator[](size_t idx) {
+    return _Get(idx, dirty_on_access_);
+  }
+
+  /**
+   * Read an element without marking its page modified, so read
+   * accesses of complex types never re-serialize a page
+   * */
+  const T& Read(size_t idx) {
+    return _Get(idx, false);
+  }
+
+  /** Write an element (its page is flushed at eviction or barrier) */
+  T& Write(size_t idx) {
+    return _Get(idx, true);
+  }
+
+  /**
+   * Read the elements [idx, idx + count) of one page. Each element
+   * counts as an access of the current transaction. count is clipped
+   * to the end of the page. The span is valid until the next access.
+   * */
+  const T* ReadSpan(size_t idx, size_t &count) {
+    count = std::min(count, elmts_per_page_ - idx % elmts_per_page_);
+    const T *data = &_Get(idx, false);
+    if (count > 1) {
+      stats_.hits_ += count - 1;
+      if (cur_tx_) {
+        cur_tx_->tail_ += count - 1;
+      }
+    }
+    return data;
+  }
+
+  /** Access an element, recording a modification if modify is set */
+  T& _Get(size_t idx, bool modify) {
     size_t page_idx = idx / elmts_per_page_;
     size_t page_off = idx % elmts_per_page_;
     Page<T> *page_ptr;
+    bool moved = false;
     if (cur_page_ && cur_page_->id_ == page_idx) {
       page_ptr = cur_page_;
+      ++stats_.hits_;
     } else {
+      moved = true;
       auto it = data_.find(page_idx);
       if (it == data_.end()) {
+        StallTimer stall(stats_);
         page_ptr = _Fault<false>(page_idx);
       } else {
         page_ptr = &it->second;
-        FinishAsyncFault<false>(*page_ptr);
+        ++stats_.hits_;
+        if (page_ptr->prefetched_) {
+          StallTimer stall(stats_);
+          ++stats_.prefetch_hits_;
+          page_ptr->prefetched_ = false;
+          FinishAsyncFault<false>(*page_ptr);
+        }
       }
     }
     if (cur_tx_) {
@@ -361,7 +1429,120 @@ class VectorMegaMpi : public Vector {
     }
     Page<T> &page = *page_ptr;
     cur_page_ = page_ptr;
-    return page.elmts_[page_off];
+    if (trace_id_ >= 0 && (moved || (modify && !page.IsDirty()))) {
+      _Trace(modify ? PageTraceOp::kWrite : PageTraceOp::kRead, idx, 1);
+    }
+    if (modify) {
+      page.MarkDirty(page_off);
+    }
+    return page.data_[page_off];
+  }
+
+  /**
+   * Elementwise reduce a small vector replicated on every rank. The
+   * elements [0, size) of each rank's copy are combined with op, and
+   * the result is written to every copy through its pages (so it is
+   * flushed to the backend like any other write).
+   * */
+  template<typename OpT>
+  void AllReduce(OpT op, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    std::vector<T> vals = _Gather(0, size_);
+    MpiReduce<T, OpT>::AllReduce(vals.data(), vals.size(), op, comm);
+    _Scatter(0, vals);
+  }
+
+  /**
+   * Reduce the range [off, off + size) of each rank (e.g., its PGAS
+   * region) into a single value, combined across all ranks
+   * */
+  template<typename OpT>
+  T AllReduce(size_t off, size_t size, const T &init,
+              OpT op, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    T val = init;
+    SeqTxBegin(off, size, MM_READ_ONLY);
+    for (size_t i = off; i < off + size; ++i) {
+      val = op(val, (*this)[i]);
+    }
+    TxEnd();
+    MpiReduce<T, OpT>::AllReduce(&val, 1, op, comm);
+    return val;
+  }
+
+  /**
+   * Elementwise reduce a small vector replicated on every rank, storing
+   * on each rank only the part of the result in its PGAS region
+   * */
+  template<typename OpT>
+  void ReduceScatter(OpT op, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    if (!bounds_.IsContiguous()) {
+      HELOG(kFatal, "ReduceScatter needs a contiguous PGAS layout");
+    }
+    std::vector<int> counts(bounds_.nprocs_);
+    for (int i = 0; i < bounds_.nprocs_; ++i) {
+      counts[i] = (int)bounds_.RegionOf(i).second;
+    }
+    std::vector<T> vals = _Gather(0, size_);
+    std::vector<T> local(local_size());
+    MpiReduce<T, OpT>::ReduceScatter(vals.data(), local.data(),
+                                     counts, op, comm);
+    _Scatter(local_off(), local);
+  }
+
+  /**
+   * Find the element with the largest key(elmt) over the range
+   * [off, off + size) of each rank
+   *
+   * @return The global index and value of the element (index SIZE_MAX
+   * if every rank's range is empty)
+   * */
+  template<typename KeyT>
+  std::pair<size_t, T> ArgMax(size_t off, size_t size,
+                              KeyT key, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    struct {
+      double key_;
+      int rank_;
+    } local, global;
+    local.key_ = std::numeric_limits<double>::lowest();
+    MPI_Comm_rank(comm, &local.rank_);
+    std::pair<size_t, T> max(SIZE_MAX, T());
+    SeqTxBegin(off, size, MM_READ_ONLY);
+    for (size_t i = off; i < off + size; ++i) {
+      T &elmt = (*this)[i];
+      double elmt_key = key(elmt);
+      if (elmt_key > local.key_) {
+        local.key_ = elmt_key;
+        max.first = i;
+        max.second = elmt;
+      }
+    }
+    TxEnd();
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE_INT, MPI_MAXLOC, comm);
+    if (global.key_ == std::numeric_limits<double>::lowest()) {
+      return std::pair<size_t, T>(SIZE_MAX, T());
+    }
+    MPI_Bcast(&max.first, sizeof(size_t), MPI_BYTE, global.rank_, comm);
+    MPI_Bcast(&max.second, sizeof(T), MPI_BYTE, global.rank_, comm);
+    return max;
+  }
+
+  /** Copy the elements [off, off + count) out of the vector */
+  std::vector<T> _Gather(size_t off, size_t count) {
+    std::vector<T> vals(count);
+    for (size_t i = 0; i < count; ++i) {
+      vals[i] = Read(off + i);
+    }
+    return vals;
+  }
+
+  /** Copy elements into the vector starting at off */
+  void _Scatter(size_t off, const std::vector<T> &vals) {
+    for (size_t i = 0; i < vals.size(); ++i) {
+      Write(off + i) = vals[i];
+    }
   }
 
   /** Size */
@@ -381,8 +1562,17 @@ class VectorMegaMpi : public Vector {
 
   /** Offset of remote PGAS region */
   size_t remote_off(int rank) const {
-    Bounds bounds(rank, bounds.nprocs_, bounds.size_);
-    return bounds.off_;
+    return bounds_.RegionOf(rank).first;
+  }
+
+  /** The rank whose PGAS region contains an element */
+  int OwnerOf(size_t idx) const {
+    return bounds_.OwnerOf(idx);
+  }
+
+  /** The contiguous ranges (offset, size) of the local PGAS region */
+  std::vector<std::pair<size_t, size_t>> LocalRanges() const {
+    return bounds_.LocalRanges();
   }
 
   /** Index of last element + 1 */
@@ -395,7 +1585,17 @@ class VectorMegaMpi : public Vector {
 
   /** Destroy region */
   void Destroy() {
+    MM_TELEMETRY->Retire(&stats_);
+    if (trace_id_ >= 0) {
+      MM_PAGE_TRACE->Flush();
+    }
     Close();
+    _ReleaseShared();
+    rma_.Finalize();
+    rma_published_ = false;
+    if (MM_NODE_CACHE->IsInitialized()) {
+      MM_NODE_CACHE->Invalidate(path_hash_, (u64)-1);
+    }
     bkt_.Destroy();
     HRUN_ADMIN->FlushRoot(DomainId::GetLocal());
   }
@@ -411,20 +1611,38 @@ class VectorMegaMpi : public Vector {
 
   /** Flush append buffer */
   void _FlushEmplace() {
+    MM_SPAN("FlushEmplaceBuffer", "io", append_data_.size());
     if constexpr(!IS_COMPLEX_TYPE) {
+      if (flags_.Any(MM_SCAN_APPEND)) {
+        _SpillSegment();
+        return;
+      }
       hermes::Context ctx;
       ctx.flags_.SetBits(HERMES_SHOULD_STAGE);
       hermes::Blob blob((char*)append_data_.data(),
                         append_data_.size() * elmt_size_);
       bkt_.Append(blob, page_size_, ctx);
+      stats_.bytes_out_ += blob.size();
       append_data_.clear();
     } else {
       throw std::runtime_error("Complex types not supported");
     }
   }
 
+  /** Flush emplace over the vector's communicator */
+  void FlushEmplace() {
+    FlushEmplace(comm_);
+  }
+
   /** Flush emplace */
   void FlushEmplace(MPI_Comm comm) {
+    MM_SPAN("FlushEmplace", "sync", append_data_.size());
+    if constexpr (!IS_COMPLEX_TYPE) {
+      if (flags_.Any(MM_SCAN_APPEND)) {
+        _ScanFlushEmplace(comm);
+        return;
+      }
+    }
     if (append_data_.size()) {
       _FlushEmplace();
     }
@@ -435,19 +1653,109 @@ class VectorMegaMpi : public Vector {
     new_size = new_size / elmt_size_;
     Resize(new_size);
     size_ = new_size;
+    append_base_ = new_size;
+    _NextEpoch();
+    Hint(MM_READ_ONLY);
+  }
+
+  /** Move a full append buffer to the private segment of this rank */
+  void _SpillSegment() {
+    if (seg_pages_ == 0) {
+      seg_bkt_ = HERMES->GetBucket(
+          hshm::Formatter::format("{}_segment_{}", bkt_name_, rank_));
+    }
+    hermes::Context ctx;
+    std::string page_name =
+        hermes::adapter::BlobPlacement::CreateBlobName(seg_pages_).str();
+    hermes::Blob blob((char*)append_data_.data(),
+                      append_data_.size() * elmt_size_);
+    seg_bkt_.Put(page_name, blob, ctx);
+    append_data_.clear();
+    ++seg_pages_;
+  }
+
+  /**
+   * Flush emplace without serializing on the bucket tail (collective).
+   * An MPI_Exscan of the appended counts gives each rank its global
+   * offset, and each rank writes its segment into the vector's pages
+   * in place, in parallel with the other ranks.
+   * */
+  void _ScanFlushEmplace(MPI_Comm comm) {
+    size_t count = seg_pages_ * elmts_per_page_ + append_data_.size();
+    size_t off = 0, total = 0;
+    MPI_Exscan(&count, &off, 1, MPI_UINT64_T, MPI_SUM, comm);
+    MPI_Allreduce(&count, &total, 1, MPI_UINT64_T, MPI_SUM, comm);
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) {
+      off = 0;
+    }
+    off += append_base_;
+    // Write the spilled pages, then the partial page
+    if (seg_pages_) {
+      std::vector<T> page(elmts_per_page_);
+      hermes::Context ctx;
+      for (size_t i = 0; i < seg_pages_; ++i) {
+        std::string page_name =
+            hermes::adapter::BlobPlacement::CreateBlobName(i).str();
+        hermes::Blob blob((char*)page.data(), page_size_);
+        seg_bkt_.Get(page_name, blob, ctx);
+        _PutRange(off + i * elmts_per_page_, page.data(), elmts_per_page_);
+      }
+      seg_bkt_.Destroy();
+      seg_pages_ = 0;
+    }
+    _PutRange(off + count - append_data_.size(),
+              append_data_.data(), append_data_.size());
+    append_data_.clear();
+    MPI_Barrier(comm);
+    MM_TRACE("{}: Appended {} elements at {} of {}",
+             rank, count, off, path_);
+    append_base_ += total;
+    Resize(append_base_);
+    _NextEpoch();
     Hint(MM_READ_ONLY);
   }
 
+  /** Write elements [idx, idx + count) into the pages they overlap */
+  void _PutRange(size_t idx, const T *elmts, size_t count) {
+    hermes::Context ctx;
+    ctx.flags_.SetBits(HERMES_SHOULD_STAGE);
+    while (count) {
+      size_t page_idx = idx / elmts_per_page_;
+      size_t page_off = idx % elmts_per_page_;
+      size_t n = std::min(count, elmts_per_page_ - page_off);
+      std::string page_name =
+          hermes::adapter::BlobPlacement::CreateBlobName(page_idx).str();
+      hermes::Blob blob((char*)elmts, n * elmt_size_);
+      bkt_.PartialPut(page_name, blob, page_off * elmt_size_, ctx);
+      stats_.bytes_out_ += n * elmt_size_;
+      idx += n;
+      elmts += n;
+      count -= n;
+    }
+  }
+
   void Rescore(size_t page_idx, size_t mod_start, size_t mod_count,
                float score, bitfield32_t flags) override {
+    if (trace_id_ >= 0 && score <= 1) {
+      _Trace(score < 1 ? PageTraceOp::kEvict : PageTraceOp::kPrefetch,
+             page_idx * elmts_per_page_ + mod_start, mod_count);
+    }
     // Flush and evict modified data
     if (score < 1) {
-      if (flags.Any(MM_READ_WRITE | MM_WRITE_ONLY)) {
-        _Flush(page_idx, mod_start, mod_count);
-      }
+      _Flush(page_idx);
       _Evict(page_idx);
     }
 
+    // Sources decode future pages in the background
+    if (src_) {
+      if (score == 1) {
+        src_->Prefetch(page_idx * elmts_per_page_, elmts_per_page_);
+      }
+      return;
+    }
+
     // Stage data to be read from storage
     hermes::Context ctx;
     if (flags.Any(MM_STAGE)) {
@@ -6,16 +6,23 @@
 #define MEGAMMAP_INCLUDE_MEGA_MMAP_VECTOR_MMAP_MPI_H_
 
 #include <string>
+#include <string_view>
+#include <limits>
+#include <memory>
 #include <mpi.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include "hermes_shm/util/logging.h"
 #include "hermes_shm/util/config_parse.h"
+#include "hermes_shm/util/random.h"
 #include "hermes_shm/data_structures/data_structure.h"
 #include <filesystem>
 #include <cereal/types/memory.hpp>
 #include <sys/resource.h>
+#include <unistd.h>
 #include "macros.h"
+#include "reduce.h"
+#include "parallel_sort.h"
 
 namespace stdfs = std::filesystem;
 
@@ -23,10 +30,31 @@ namespace mm {
 
 template<typename T>
 struct VectorMmapEntry {
-  bool modified_ = false;
+  bool modified_ = false;  /**< Written since the last barrier */
+  bool loaded_ = false;    /**< data_ was deserialized from the backend */
+  u64 hash_ = 0;           /**< Hash of the backend bytes of data_ */
   T data_;
 };
 
+/**
+ * An access pattern over a range of a VectorMmapMpi. The kernel is
+ * told about it with madvise: the window ahead of the cursor is
+ * prefetched and the pages behind it are released, so the resident
+ * set stays within the vector's window.
+ * */
+struct MmapTx {
+  size_t off_ = 0;        /**< First element of the range */
+  size_t size_ = 0;       /**< Elements in the range */
+  size_t tail_ = 0;       /**< Accesses so far */
+  size_t next_ = 0;       /**< Access count of the next advice */
+  size_t advised_ = 0;    /**< End of the prefetched elements */
+  size_t released_ = 0;   /**< End of the released elements */
+  bool seq_ = true;       /**< Sequential (or random) access */
+  bitfield32_t flags_;    /**< Access flags of the transaction */
+  hshm::UniformDistribution gen_;  /**< Page generator (random access) */
+  size_t base_ = 0;       /**< First element of the current random page */
+};
+
 /** Forward declaration */
 template<typename T, bool IS_COMPLEX_TYPE=false>
 class VectorMmapMpiIterator;
@@ -44,9 +72,21 @@ class VectorMmapMpi {
   std::vector<T> back_data_;
   std::string path_;
   std::string dir_;
+  MPI_Comm comm_ = MPI_COMM_WORLD;  /**< Ranks sharing the vector */
   int rank_, nprocs_;
+  int fd_ = -1;              /**< The mapped file */
   size_t window_size_ = 0;
+  size_t elmts_per_page_ = 1;  /**< Elements per (prefetch) page */
+  size_t append_base_ = 0;   /**< Elements appended before the last flush */
+  bool owns_file_ = false;   /**< Destroy removes the file */
+  bool owns_map_ = false;    /**< Close unmaps data_ and closes fd_ */
   bitfield32_t flags_;
+  Bounds bounds_;            /**< Split of the vector among ranks */
+  PGAS pgas_;                /**< The local region */
+  MmapTx tx_;                /**< The current transaction */
+  bool in_tx_ = false;       /**< Whether tx_ is active */
+  std::vector<u64> written_; /**< Slots written since the last barrier */
+  bool synced_ = false;      /**< Every slot was deserialized once */
 
  public:
   VectorMmapMpi() = default;
@@ -58,34 +98,139 @@ class VectorMmapMpi {
     Init(path, count, flags);
   }
 
-  /** Copy constructor */
-  VectorMmapMpi(const VectorMmapMpi<T> &other) {
+  /** Copy constructor (shares the mapping of other) */
+  VectorMmapMpi(const VectorMmapMpi &other) {
+    _Copy(other);
+  }
+
+  /** Copy assignment operator (shares the mapping of other) */
+  VectorMmapMpi& operator=(const VectorMmapMpi &other) {
+    if (this != &other) {
+      Close();
+      _Copy(other);
+    }
+    return *this;
+  }
+
+  /** Move constructor (takes over the mapping of other) */
+  VectorMmapMpi(VectorMmapMpi &&other) noexcept {
+    _Move(other);
+  }
+
+  /** Move assignment operator (takes over the mapping of other) */
+  VectorMmapMpi& operator=(VectorMmapMpi &&other) noexcept {
+    if (this != &other) {
+      Close();
+      _Move(other);
+    }
+    return *this;
+  }
+
+  /** Copy the view of other, without owning its mapping */
+  void _Copy(const VectorMmapMpi &other) {
     data_ = other.data_;
     off_ = other.off_;
     size_ = other.size_;
     max_size_ = other.max_size_;
     elmt_size_ = other.elmt_size_;
+    comm_ = other.comm_;
     rank_ = other.rank_;
     nprocs_ = other.nprocs_;
+    fd_ = other.fd_;
+    window_size_ = other.window_size_;
+    elmts_per_page_ = other.elmts_per_page_;
+    append_base_ = other.append_base_;
+    flags_ = other.flags_;
+    bounds_ = other.bounds_;
+    pgas_ = other.pgas_;
+    real_data_.clear();
     if constexpr (IS_COMPLEX_TYPE) {
       real_data_.resize(size_);
     }
+    written_.clear();
+    synced_ = false;
+    owns_file_ = false;
+    owns_map_ = false;
     path_ = other.path_;
     dir_ = other.dir_;
   }
 
+  /** Take over the mapping and state of other */
+  void _Move(VectorMmapMpi &other) {
+    _Copy(other);
+    real_data_ = std::move(other.real_data_);
+    back_data_ = std::move(other.back_data_);
+    written_ = std::move(other.written_);
+    synced_ = other.synced_;
+    owns_file_ = other.owns_file_;
+    owns_map_ = other.owns_map_;
+    tx_ = other.tx_;
+    in_tx_ = other.in_tx_;
+    other.owns_file_ = false;
+    other.owns_map_ = false;
+    other.data_ = nullptr;
+    other.fd_ = -1;
+  }
+
+  /**
+   * Initialize the vector over the ranks of comm. Barriers, flushes,
+   * and PGAS splits then only involve comm. (A distinct name, since
+   * MPI_Comm is an int under MPICH.)
+   * */
+  template<typename ...Args>
+  void InitComm(MPI_Comm comm, Args&& ...args) {
+    comm_ = comm;
+    Init(std::forward<Args>(args)...);
+  }
+
   /** Explicit initializer */
   void Init(const std::string &path,
             u32 flags) {
-    size_t data_size = stdfs::file_size(path);
+    size_t data_size = 0;
+    if (stdfs::exists(path)) {
+      data_size = stdfs::file_size(path);
+    }
     size_t size = data_size / sizeof(T);
     Init(path, size, flags);
   }
 
-  /** Explicit initializer */
+  /**
+   * Explicit initializer. Complex types are serialized into 4KB slots,
+   * unless an element size is given.
+   * */
   void Init(const std::string &path, size_t count,
             u32 flags) {
-    Init(path, count, sizeof(T), flags);
+    Init(path, count, IS_COMPLEX_TYPE ? KILOBYTES(4) : sizeof(T), flags);
+  }
+
+  /**
+   * Explicit initializer for a vector decoded from a data source
+   * (collective). Each rank decodes an even share of the source into a
+   * scratch file ({path}.mmap), which is then mapped like a binary
+   * file. Destroy removes the scratch file.
+   * */
+  template<typename SrcT>
+  void Init(const std::string &path,
+            const std::shared_ptr<SrcT> &src,
+            u32 flags) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be decoded");
+    if (data_ != nullptr) {
+      return;
+    }
+    size_t count = src->Size();
+    Init(path + ".mmap", count, sizeof(T), flags);
+    owns_file_ = true;
+    Bounds share(rank_, nprocs_, count);
+    size_t chunk = src->PageElmts() ? src->PageElmts() : elmts_per_page_;
+    for (size_t off = share.off_; off < share.off_ + share.size_;
+         off += chunk) {
+      size_t n = std::min(chunk, share.off_ + share.size_ - off);
+      src->Read(off, n, (char*)(data_ + off));
+      // Decoded pages are written back lazily; keep them out of the
+      // resident set
+      _Madvise(off, n, MADV_DONTNEED, true);
+    }
+    MPI_Barrier(comm_);
   }
 
   /** Explicit initializer */
@@ -96,41 +241,293 @@ class VectorMmapMpi {
     }
     path_ = path;
     dir_ = stdfs::path(path).parent_path();
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
-    MPI_Comm_size(MPI_COMM_WORLD, &nprocs_);
-    int fd = open64(path.c_str(), O_RDWR | O_CREAT, 0666);
-    if (fd < 0) {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &nprocs_);
+    fd_ = open64(path.c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd_ < 0) {
       HELOG(kFatal, "Failed to open file {}: {}",
             path.c_str(), strerror(errno));
     }
-    size_t file_size = count * elmt_size;
-    if (ftruncate64(fd, (ssize_t)(file_size)) < 0) {
-      HELOG(kFatal, "Failed to truncate file {}: {}",
-              path.c_str(), strerror(errno));
-    }
-    data_ = (T*)mmap64(NULL, file_size, PROT_READ | PROT_WRITE,
-                       MAP_SHARED, fd, 0);
-    if (data_ == MAP_FAILED || data_ == nullptr) {
-      data_ = nullptr;
-      HELOG(kFatal, "Failed to mmap file {}: {}",
-            path.c_str(), strerror(errno));
-    }
+    elmt_size_ = elmt_size;
+    _Map(count);
+    owns_map_ = true;
     if constexpr (IS_COMPLEX_TYPE) {
       real_data_.resize(count);
     }
     off_ = 0;
     size_ = count;
-    max_size_ = count;
-    elmt_size_ = elmt_size;
     flags_ = bitfield32_t(flags);
+    if (flags_.Any(MM_APPEND_ONLY)) {
+      size_ = 0;
+    }
+    append_base_ = size_;
+    owns_file_ = !flags_.Any(MM_READ_ONLY | MM_STAGE);
+    elmts_per_page_ = std::max<size_t>(MM_PAGE_SIZE / elmt_size_, 1);
     MaximizeFds();
   }
 
+  /**
+   * Size the file to count elements and (re)map it. A remap may move
+   * the mapping, which copies and subsets would still point to, so
+   * only a vector without live copies may grow.
+   * */
+  void _Map(size_t count) {
+    if (data_ != nullptr && !owns_map_) {
+      HELOG(kFatal, "Cannot remap {} through a copy or subset", path_);
+    }
+    size_t file_size = count * elmt_size_;
+    if (ftruncate64(fd_, (ssize_t)(file_size)) < 0) {
+      HELOG(kFatal, "Failed to truncate file {}: {}",
+            path_.c_str(), strerror(errno));
+    }
+    // Empty files are mapped with one byte, since mmap rejects length 0
+    void *data;
+    if (data_ == nullptr) {
+      data = mmap64(NULL, std::max<size_t>(file_size, 1),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    } else {
+      data = mremap(data_, std::max<size_t>(max_size_ * elmt_size_, 1),
+                    std::max<size_t>(file_size, 1), MREMAP_MAYMOVE);
+    }
+    if (data == MAP_FAILED || data == nullptr) {
+      data_ = nullptr;
+      HELOG(kFatal, "Failed to mmap file {}: {}",
+            path_.c_str(), strerror(errno));
+    }
+    data_ = (T*)data;
+    max_size_ = count;
+  }
+
+  /** The file is mapped by Init */
+  void Allocate() {}
+
+  /** Stage in over the vector's communicator */
+  void StageIn() {
+    StageIn(comm_);
+  }
+
+  /**
+   * Prefetch the start of the local region into the page cache. The
+   * kernel reads the pages, so unlike a paged backend no collective I/O
+   * is done and comm is unused.
+   *
+   * @param comm Unused (the signature is shared with paged backends)
+   * @param round_size Max bytes prefetched (0: window size, or the
+   * whole region if unbounded)
+   * */
+  void StageIn(MPI_Comm comm, size_t round_size = 0) {
+    size_t count = local_size();
+    if (round_size == 0) {
+      round_size = window_size_;
+    }
+    if (round_size) {
+      count = std::min(count, std::max<size_t>(round_size / elmt_size_, 1));
+    }
+    _Madvise(local_off(), count, MADV_WILLNEED, false);
+  }
+
   void BoundMemory(size_t window_size) {
     window_size_ = window_size;
   }
 
+  /**
+   * Evenly split the vector among processes. count_per_page sets the
+   * elements per (prefetch) page, if not 0.
+   * */
+  void EvenPgas(int rank, int nprocs, size_t max_count,
+                size_t count_per_page = 0) {
+    if (count_per_page != 0) {
+      elmts_per_page_ = count_per_page;
+    }
+    bounds_ = Bounds(rank, nprocs, max_count);
+    Pgas(bounds_.off_, bounds_.size_);
+  }
+
+  /** Evenly split the vector among the ranks of its communicator */
+  void EvenPgas(size_t max_count) {
+    EvenPgas(rank_, nprocs_, max_count);
+  }
+
+  /** Set the local region */
   void Pgas(size_t off, size_t size) {
+    pgas_.Init(off, size, elmts_per_page_);
+  }
+
+  /** Size of PGAS region */
+  size_t local_size() const {
+    return pgas_.size_;
+  }
+
+  /** Offset of local PGAS region */
+  size_t local_off() const {
+    return pgas_.off_;
+  }
+
+  /** Index of last element + 1 */
+  size_t local_last() const {
+    return pgas_.off_ + pgas_.size_;
+  }
+
+  /** Begin a sequential transaction */
+  void SeqTxBegin(size_t off, size_t size, u32 flags) {
+    tx_ = MmapTx();
+    tx_.off_ = off;
+    tx_.size_ = size;
+    tx_.advised_ = off;
+    tx_.released_ = off;
+    tx_.flags_.SetBits(flags);
+    in_tx_ = true;
+    _Madvise(off, size, MADV_SEQUENTIAL, false);
+    _Slide();
+  }
+
+  /** Begin a PGAS transaction (sequential over the local region) */
+  void PgasTxBegin(size_t off, size_t size, u32 flags) {
+    SeqTxBegin(off, size, flags);
+  }
+
+  /** Begin a random transaction over [rand_left, rand_left + rand_size) */
+  void RandTxBegin(size_t seed, size_t rand_left, size_t rand_size,
+                   size_t size, u32 flags) {
+    tx_ = MmapTx();
+    tx_.off_ = rand_left;
+    tx_.size_ = rand_size;
+    tx_.seq_ = false;
+    tx_.flags_.SetBits(flags);
+    tx_.gen_.Seed(seed);
+    tx_.gen_.Shape((double)rand_left,
+                   (double)rand_left + (double)rand_size);
+    tx_.next_ = _WindowElmts();
+    in_tx_ = true;
+    _Madvise(rand_left, rand_size, MADV_RANDOM, false);
+  }
+
+  /**
+   * Get the index of the next access of a random transaction. Like
+   * RandIterTx, a random page is chosen and then read sequentially.
+   * */
+  template<typename TxT>
+  size_t TxGetIdx() {
+    size_t off = tx_.tail_ % elmts_per_page_;
+    if (off == 0) {
+      size_t page_idx = tx_.gen_.GetSize() / elmts_per_page_;
+      tx_.base_ = page_idx * elmts_per_page_;
+    }
+    return std::min(tx_.base_ + off, tx_.off_ + tx_.size_ - 1);
+  }
+
+  /** Get the value at the current iterator point */
+  template<typename TxT>
+  T& TxGet() {
+    size_t idx = TxGetIdx<TxT>();
+    return (*this)[idx];
+  }
+
+  /** End a transaction, releasing the rest of its range */
+  void TxEnd() {
+    if (!in_tx_) {
+      return;
+    }
+    in_tx_ = false;
+    if (window_size_) {
+      size_t end = tx_.off_ + tx_.size_;
+      _Release(tx_.seq_ ? tx_.released_ : tx_.off_, end, true);
+    }
+    _Madvise(tx_.off_, tx_.size_, MADV_NORMAL, false);
+  }
+
+  /** Elements which fit in the window (0 if unbounded) */
+  size_t _WindowElmts() const {
+    return window_size_ / elmt_size_;
+  }
+
+  /** Advance the transaction cursor */
+  void _Step() {
+    if (++tx_.tail_ < tx_.next_) {
+      return;
+    }
+    if (tx_.seq_) {
+      _Slide();
+    } else {
+      // Random accesses cannot be predicted: drop the range each window
+      _Release(tx_.off_, tx_.off_ + tx_.size_, true);
+      tx_.next_ = tx_.tail_ + _WindowElmts();
+    }
+  }
+
+  /**
+   * Prefetch half a window ahead of the cursor, and release what lies
+   * more than half a window behind it
+   * */
+  void _Slide() {
+    size_t end = tx_.off_ + tx_.size_;
+    size_t cur = tx_.off_ + std::min(tx_.tail_, tx_.size_);
+    size_t half = _WindowElmts() / 2;
+    if (half == 0) {
+      half = elmts_per_page_;
+    }
+    size_t ahead = std::min(cur + half, end);
+    if (ahead > tx_.advised_) {
+      size_t first = std::max(tx_.advised_, cur);
+      _Madvise(first, ahead - first, MADV_WILLNEED, false);
+      tx_.advised_ = ahead;
+    }
+    if (window_size_ && cur > tx_.off_ + half) {
+      _Release(tx_.released_, cur - half, false);
+    }
+    tx_.next_ = tx_.tail_ + std::max<size_t>(half / 2, 1);
+  }
+
+  /**
+   * Drop elements [start, end) from the resident set. Written pages
+   * are paged out (written back); clean pages are only unmapped and
+   * stay in the page cache.
+   * */
+  void _Release(size_t start, size_t end, bool round_up) {
+    if (end <= start) {
+      return;
+    }
+    int advice = MADV_DONTNEED;
+#ifdef MADV_PAGEOUT
+    if (tx_.flags_.Any(MM_WRITE_ONLY | MM_READ_WRITE)) {
+      advice = MADV_PAGEOUT;
+    }
+#endif
+    if (_Madvise(start, end - start, advice, !round_up)) {
+      tx_.released_ = std::max(tx_.released_, end);
+    }
+  }
+
+  /**
+   * Advise the kernel about elements [idx, idx + count)
+   *
+   * @param round_down Shrink the range to whole pages, so pages still
+   * partially in use are not released
+   * @return Whether any page was advised
+   * */
+  bool _Madvise(size_t idx, size_t count, int advice, bool round_down) {
+    if constexpr (IS_COMPLEX_TYPE) {
+      return false;
+    } else {
+      if (data_ == nullptr || count == 0) {
+        return false;
+      }
+      static const size_t kPage = sysconf(_SC_PAGESIZE);
+      char *base = (char*)data_;
+      size_t start = (off_ + idx) * elmt_size_;
+      size_t end = std::min((off_ + idx + count) * elmt_size_,
+                            max_size_ * elmt_size_);
+      start = start / kPage * kPage;
+      end = round_down ? end / kPage * kPage :
+          (end + kPage - 1) / kPage * kPage;
+      end = std::min(end, (max_size_ * elmt_size_ + kPage - 1) /
+          kPage * kPage);
+      if (end <= start) {
+        return false;
+      }
+      madvise(base + start, end - start, advice);
+      return true;
+    }
   }
 
   VectorMmapMpi Subset(size_t off, size_t size) {
@@ -172,47 +569,120 @@ class VectorMmapMpi {
     return count;
   }
 
-  /** Serialize the in-memory cache back to backend */
+  /** Hash the backend bytes of an element */
+  u64 _HashBackend(const char *elmt_data) const {
+    return std::hash<std::string_view>{}(
+        std::string_view(elmt_data, elmt_size_));
+  }
+
+  /** Serialize the elements written since the last barrier */
   void _SerializeToBackend() {
     if constexpr (IS_COMPLEX_TYPE) {
-      for (size_t i = 0; i < size_; ++i) {
-        const VectorMmapEntry<T> &elmt = real_data_[i];
-        if (elmt.modified_) {
-          std::stringstream ss;
-          cereal::BinaryOutputArchive ar(ss);
-          ar(elmt.data_);
-          std::string srl = ss.str();
-          size_t off = i * elmt_size_;
-          if (srl.size() > elmt_size_) {
-            HELOG(kFatal, "Serialization size {} is larger than element size {}",
-                  srl.size(), elmt_size_);
-          }
-          memcpy((char*)data_ + off_ + off,
-                 srl.c_str(), srl.size());
+      for (u64 slot : written_) {
+        size_t i = slot - off_;
+        VectorMmapEntry<T> &elmt = real_data_[i];
+        std::stringstream ss;
+        cereal::BinaryOutputArchive ar(ss);
+        ar(elmt.data_);
+        std::string srl = ss.str();
+        char *elmt_data = (char*)data_ + (off_ + i) * elmt_size_;
+        if (srl.size() > elmt_size_) {
+          HELOG(kFatal, "Serialization size {} is larger than element size {}",
+                srl.size(), elmt_size_);
         }
+        memcpy(elmt_data, srl.c_str(), srl.size());
+        elmt.hash_ = _HashBackend(elmt_data);
+        elmt.loaded_ = true;
+        elmt.modified_ = false;
       }
     }
   }
 
-  /** Deserialize in-memory cache from backend */
-  void _DeserializeFromBackend() {
+  /**
+   * Gather the slots every other rank wrote since the last barrier
+   * (collective; also synchronizes the ranks like MPI_Barrier)
+   * */
+  std::vector<u64> _ExchangeWritten(MPI_Comm comm) {
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+    int count = (int)written_.size();
+    std::vector<int> counts(nprocs), displs(nprocs);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+    int total = 0;
+    for (int i = 0; i < nprocs; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+    std::vector<u64> all(total);
+    MPI_Allgatherv(written_.data(), count, MPI_UINT64_T,
+                   all.data(), counts.data(), displs.data(),
+                   MPI_UINT64_T, comm);
+    written_.clear();
+    // Our own writes are already deserialized
+    std::vector<u64> modified;
+    for (int i = 0; i < nprocs; ++i) {
+      if (i == rank) {
+        continue;
+      }
+      modified.insert(modified.end(), all.begin() + displs[i],
+                      all.begin() + displs[i] + counts[i]);
+    }
+    return modified;
+  }
+
+  /** Deserialize slot off_ + i if its backend bytes changed */
+  void _DeserializeSlot(size_t i) {
+    char *elmt_data = (char*)data_ + (off_ + i) * elmt_size_;
+    VectorMmapEntry<T> &elmt = real_data_[i];
+    u64 hash = _HashBackend(elmt_data);
+    if (elmt.loaded_ && elmt.hash_ == hash) {
+      return;
+    }
+    std::stringstream ss(std::string(elmt_data, elmt_size_));
+    cereal::BinaryInputArchive ar(ss);
+    ar(elmt.data_);
+    elmt.hash_ = hash;
+    elmt.loaded_ = true;
+    elmt.modified_ = false;
+  }
+
+  /**
+   * Deserialize the slots other ranks wrote. The first barrier reads
+   * every slot, since the file may hold data from before Init.
+   * */
+  void _DeserializeFromBackend(const std::vector<u64> &modified) {
     if constexpr (IS_COMPLEX_TYPE) {
-      for (size_t i = 0; i < size_; ++i) {
-        char *elmt_data = (char*)data_ + (off_ + i) * elmt_size_;
-        VectorMmapEntry<T> &elmt = real_data_[i];
-        std::stringstream ss(std::string(elmt_data, elmt_size_));
-        cereal::BinaryInputArchive ar(ss);
-        ar(elmt.data_);
-        elmt.modified_ = false;
+      if (!synced_) {
+        for (size_t i = 0; i < size_; ++i) {
+          _DeserializeSlot(i);
+        }
+        synced_ = true;
+        return;
+      }
+      for (u64 slot : modified) {
+        if (off_ <= slot && slot < off_ + size_) {
+          _DeserializeSlot(slot - off_);
+        }
       }
     }
   }
 
+  /** Lock a region over the vector's communicator */
+  void Barrier(u32 flags = 0) {
+    Barrier(flags, comm_);
+  }
+
   /** Lock a region */
-  void Barrier(u32 flags = 0, MPI_Comm comm = MPI_COMM_WORLD) {
+  void Barrier(u32 flags, MPI_Comm comm) {
     _SerializeToBackend();
-    MPI_Barrier(comm);
-    _DeserializeFromBackend();
+    std::vector<u64> modified;
+    if constexpr (IS_COMPLEX_TYPE) {
+      modified = _ExchangeWritten(comm);
+    } else {
+      MPI_Barrier(comm);
+    }
+    _DeserializeFromBackend(modified);
     flags_.SetBits(flags);
   }
 
@@ -221,17 +691,106 @@ class VectorMmapMpi {
     flags_.SetBits(flags);
   }
 
-  /** Index operator */
+  /** Index operator (assumes the element is written) */
   T& operator[](size_t idx) {
+    return Write(idx);
+  }
+
+  /** Read an element without marking it modified */
+  const T& Read(size_t idx) {
+    if constexpr (!IS_COMPLEX_TYPE) {
+      if (in_tx_) {
+        _Step();
+      }
+      return data_[off_ + idx];
+    } else {
+      return real_data_[idx].data_;
+    }
+  }
+
+  /** Write an element (it is serialized at the next barrier) */
+  T& Write(size_t idx) {
     if constexpr (!IS_COMPLEX_TYPE) {
+      if (in_tx_) {
+        _Step();
+      }
       return data_[off_ + idx];
     } else {
       VectorMmapEntry<T> &entry = real_data_[idx];
-      entry.modified_ = true;
+      if (!entry.modified_) {
+        entry.modified_ = true;
+        written_.emplace_back(off_ + idx);
+      }
       return entry.data_;
     }
   }
 
+  /**
+   * Elementwise reduce a small vector replicated on every rank (i.e.,
+   * each rank maps its own file), storing the result in every copy
+   * */
+  template<typename OpT>
+  void AllReduce(OpT op, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    MpiReduce<T, OpT>::AllReduce(data_ + off_, size_, op, comm);
+  }
+
+  /**
+   * Reduce the range [off, off + size) of each rank (e.g., its PGAS
+   * region) into a single value, combined across all ranks
+   * */
+  template<typename OpT>
+  T AllReduce(size_t off, size_t size, const T &init,
+              OpT op, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    T val = init;
+    SeqTxBegin(off, size, MM_READ_ONLY);
+    for (size_t i = off; i < off + size; ++i) {
+      val = op(val, (*this)[i]);
+    }
+    TxEnd();
+    MpiReduce<T, OpT>::AllReduce(&val, 1, op, comm);
+    return val;
+  }
+
+  /**
+   * Find the element with the largest key(elmt) over the range
+   * [off, off + size) of each rank
+   *
+   * @return The global index and value of the element (index SIZE_MAX
+   * if every rank's range is empty)
+   * */
+  template<typename KeyT>
+  std::pair<size_t, T> ArgMax(size_t off, size_t size,
+                              KeyT key, MPI_Comm comm) {
+    static_assert(!IS_COMPLEX_TYPE, "Only plain types can be reduced");
+    struct {
+      double key_;
+      int rank_;
+    } local, global;
+    local.key_ = std::numeric_limits<double>::lowest();
+    MPI_Comm_rank(comm, &local.rank_);
+    std::pair<size_t, T> max(SIZE_MAX, T());
+    SeqTxBegin(off, size, MM_READ_ONLY);
+    for (size_t i = off; i < off + size; ++i) {
+      T &elmt = (*this)[i];
+      double elmt_key = key(elmt);
+      if (elmt_key > local.key_) {
+        local.key_ = elmt_key;
+        max.first = i;
+        max.second = elmt;
+      }
+    }
+    TxEnd();
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE_INT, MPI_MAXLOC, comm);
+    if (global.key_ == std::numeric_limits<double>::lowest()) {
+      return std::pair<size_t, T>(SIZE_MAX, T());
+    }
+    MPI_Bcast(&max.first, sizeof(size_t), MPI_BYTE, global.rank_, comm);
+    MPI_Bcast(&max.second, sizeof(T), MPI_BYTE, global.rank_, comm);
+    return max;
+  }
+
   /** Addition operator */
   VectorMmapMpi<T> operator+(size_t idx) {
     return Subset(off_ + idx, size_ - idx);
@@ -274,10 +833,10 @@ class VectorMmapMpi {
                           data_ + off_ + off + size);
   }
 
-  /** Sort a subset */
+  /** Sort a subset (in parallel with OpenMP) */
   void Sort(size_t off, size_t size) {
-      std::sort(data_ + off_ + off,
-                data_ + off_ + off + size);
+    ParallelSort(data_ + off_ + off,
+                 data_ + off_ + off + size);
   }
 
   /** Size */
@@ -295,15 +854,41 @@ class VectorMmapMpi {
     return VectorMmapMpiIterator<T, IS_COMPLEX_TYPE>(this, size());
   }
 
-  /** Close region */
+  /**
+   * Close region. Copies and subsets share the mapping and fd of the
+   * vector they came from, so only that vector unmaps and closes them.
+   * */
   void Close() {
-    munmap(data_, max_size_ * elmt_size_);
+    if (data_ == nullptr) {
+      return;
+    }
+    if (owns_map_) {
+      munmap(data_, std::max<size_t>(max_size_ * elmt_size_, 1));
+      close(fd_);
+      owns_map_ = false;
+    }
+    data_ = nullptr;
+    fd_ = -1;
   }
 
-  /** Destroy region */
+  /**
+   * Destroy region (collective). Files opened as inputs (MM_READ_ONLY
+   * or MM_STAGE) stay mapped, and only their resident pages are
+   * dropped, like a paged backend dropping its staged copy. Others are
+   * removed once every rank has unmapped them, so a vector of the same
+   * name can be created next.
+   * */
   void Destroy() {
+    if (!owns_file_) {
+      _Madvise(0, max_size_ - off_, MADV_DONTNEED, false);
+      return;
+    }
     Close();
-    remove(path_.c_str());
+    MPI_Barrier(comm_);
+    if (rank_ == 0) {
+      remove(path_.c_str());
+    }
+    MPI_Barrier(comm_);
   }
 
   /** Emplace back */
@@ -312,14 +897,48 @@ class VectorMmapMpi {
     back_data_.emplace_back(elmt);
   }
 
+  /** Flush emplace over the vector's communicator */
+  void FlushEmplace() {
+    FlushEmplace(comm_);
+  }
+
+  /**
+   * Append the emplaced elements of every rank to the file (collective).
+   * The elements of each rank follow those of lower ranks. The file is
+   * remapped, so copies and subsets of the vector must not outlive it.
+   * */
+  void FlushEmplace(MPI_Comm comm) {
+    if constexpr (IS_COMPLEX_TYPE) {
+      HELOG(kFatal, "Complex types cannot be emplaced");
+    } else {
+      int rank;
+      MPI_Comm_rank(comm, &rank);
+      u64 count = back_data_.size(), off = 0, total = 0;
+      MPI_Exscan(&count, &off, 1, MPI_UINT64_T, MPI_SUM, comm);
+      MPI_Allreduce(&count, &total, 1, MPI_UINT64_T, MPI_SUM, comm);
+      if (rank == 0) {
+        off = 0;
+      }
+      size_t new_size = append_base_ + total;
+      // Every rank truncates to the same size, so no data is lost
+      _Map(new_size);
+      memcpy(static_cast<void*>(data_ + append_base_ + off),
+             back_data_.data(), count * sizeof(T));
+      back_data_.clear();
+      MPI_Barrier(comm);
+      off_ = 0;
+      size_ = new_size;
+      append_base_ = new_size;
+      Hint(MM_READ_ONLY);
+    }
+  }
+
   /** Flush emplace */
   void flush_emplace(MPI_Comm comm, int proc_off, int nprocs) {
     std::string flush_map = hshm::Formatter::format(
         "{}_flusher_{}_{}", path_, proc_off, nprocs);
-    VectorMmapMpi<size_t, false> back(
-        flush_map,
-        nprocs,
-        MM_WRITE_ONLY);
+    VectorMmapMpi<size_t, false> back;
+    back.InitComm(comm, flush_map, nprocs, MM_WRITE_ONLY);
     back[rank_ - proc_off] = back_data_.size();
     back.Barrier(MM_READ_ONLY, comm);
     size_t my_off = 0, new_size = 0;